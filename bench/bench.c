@@ -0,0 +1,471 @@
+/**
+ * Throughput benchmark for the Huffman coding stages.
+ *
+ * Generates deterministic synthetic corpora and times histogram, tree
+ * build, table build, encode and decode separately over several
+ * repetitions, optionally with hardware performance counters. Results
+ * can be saved as JSON and compared against a saved baseline, exiting
+ * non-zero when a stage got significantly slower.
+ * @file
+ */
+#include <argp.h>
+#include <error.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "counters.h"
+#include "huffman.h"
+#include "results.h"
+
+#define DEFAULT_REPETITIONS 5
+#define DEFAULT_THRESHOLD 5
+
+const char *argp_program_version =
+    "bench 0.1";
+
+static char doc[] =
+    "Huffman benchmark -- Measure encode/decode throughput per stage.";
+
+static struct argp_option options[] = {
+    {"repetitions", 'r', "N",      0, "Repeat each measurement N times" },
+    {"size",        's', "BYTES",  0, "Run corpora of BYTES bytes instead of the default sizes" },
+    {"corpus",      'c', "NAME",   0, "Only run corpus NAME" },
+    {"json",        'j', "FILE",   0, "Write results as JSON to FILE (- for stdout)" },
+    {"compare",     'b', "FILE",   0, "Compare results with baseline JSON FILE" },
+    {"threshold",   't', "PCT",    0, "Ignore slowdowns below PCT percent (default 5)" },
+    {"counters",    'p', 0,        0, "Collect hardware performance counters per stage" },
+    { 0 }
+};
+
+struct arguments
+{
+    int repetitions;
+    size_t size;
+    char *corpus;
+    char *json_file;
+    char *baseline_file;
+    double threshold;
+    int counters;
+};
+
+typedef enum stage {
+    STAGE_HISTOGRAM,
+    STAGE_TREE,
+    STAGE_TABLE,
+    STAGE_ENCODE,
+    STAGE_DECODE,
+    NUM_STAGES
+} stage_t;
+
+static const char *stage_names[NUM_STAGES] = {
+    "histogram", "tree", "table", "encode", "decode"
+};
+
+typedef struct corpus {
+    const char *name;
+    void (*generate)(char *data, size_t size, uint64_t *seed);
+} corpus_t;
+
+static size_t sizes[] = { 64 << 10, 1 << 20, 8 << 20 };
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state)
+{
+    struct arguments *arguments = state->input;
+
+    switch (key) {
+        case 'r':
+            arguments->repetitions = atoi(arg);
+            if (arguments->repetitions < 1)
+                argp_error(state, "invalid repetition count '%s'", arg);
+            break;
+        case 's':
+            arguments->size = strtoul(arg, NULL, 10);
+            if (arguments->size == 0)
+                argp_error(state, "invalid size '%s'", arg);
+            break;
+        case 'c':
+            arguments->corpus = arg;
+            break;
+        case 'j':
+            arguments->json_file = arg;
+            break;
+        case 'b':
+            arguments->baseline_file = arg;
+            break;
+        case 't':
+            arguments->threshold = atof(arg);
+            break;
+        case 'p':
+            arguments->counters = 1;
+            break;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+static struct argp argp = { options, parse_opt, NULL, doc };
+
+/*
+ * Corpus generators
+ */
+
+// xorshift64* so corpora are identical on every run and platform
+uint64_t next_random(uint64_t *seed)
+{
+    *seed ^= *seed >> 12;
+    *seed ^= *seed << 25;
+    *seed ^= *seed >> 27;
+    return *seed * 2685821657736338717ULL;
+}
+
+double next_double(uint64_t *seed)
+{
+    return (next_random(seed) >> 11) * (1.0 / (1ULL << 53));
+}
+
+void generate_uniform(char *data, size_t size, uint64_t *seed)
+{
+    for (size_t i = 0; i < size; i++) {
+        data[i] = next_random(seed) >> 56;
+    }
+}
+
+void generate_zipf(char *data, size_t size, uint64_t *seed)
+{
+    double cdf[256];
+    double sum = 0;
+
+    for (int i = 0; i < 256; i++) {
+        sum += 1.0 / pow(i + 1, 1.1);
+        cdf[i] = sum;
+    }
+
+    for (size_t i = 0; i < size; i++) {
+        double r = next_double(seed) * sum;
+        int low = 0;
+        int high = 255;
+
+        while (low < high) {
+            int middle = (low + high) / 2;
+            if (cdf[middle] < r)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+
+        data[i] = low;
+    }
+}
+
+void generate_text(char *data, size_t size, uint64_t *seed)
+{
+    static const char *words[] = {
+        "the", "of", "and", "to", "a", "in", "is", "it", "you", "that", "he", "was", "for",
+        "on", "are", "with", "as", "his", "they", "be", "at", "one", "have", "this", "from",
+        "or", "had", "by", "word", "but", "what", "some", "we", "can", "out", "other", "were",
+        "all", "there", "when", "up", "use", "your", "how", "said", "an", "each", "she",
+        "which", "do", "their", "time", "if", "will", "way", "about", "many", "then", "them",
+        "write", "would", "like", "so", "these", "her", "long", "make", "thing", "see", "him",
+        "two", "has", "look", "more", "day", "could", "go", "come", "did", "number", "sound",
+        "no", "most", "people", "my", "over", "know", "water", "than", "call", "first", "who",
+        "may", "down", "side", "been", "now", "find", "compression", "entropy", "huffman"
+    };
+    int num_words = sizeof(words) / sizeof(words[0]);
+    size_t i = 0;
+    int sentence = 0;
+
+    while (i < size) {
+        // earlier words are more common
+        double r = next_double(seed);
+        const char *word = words[(int) (r * r * num_words)];
+
+        for (int j = 0; word[j] != '\0' && i < size; j++) {
+            data[i++] = (sentence == 0 && j == 0) ? word[j] - 'a' + 'A' : word[j];
+        }
+
+        if (++sentence > 4 + (int) (next_random(seed) % 12)) {
+            sentence = 0;
+            if (i < size) data[i++] = '.';
+            if (i < size) data[i++] = (next_random(seed) % 8 == 0) ? '\n' : ' ';
+        } else if (i < size) {
+            data[i++] = (next_random(seed) % 16 == 0) ? ',' : ' ';
+            if (data[i - 1] == ',' && i < size) data[i++] = ' ';
+        }
+    }
+}
+
+// fixed-size records of counters, small integers, flags and padding
+void generate_binary(char *data, size_t size, uint64_t *seed)
+{
+    uint32_t id = 0;
+    size_t i = 0;
+
+    while (i < size) {
+        uint8_t record[16] = { 0 };
+        uint16_t small = next_random(seed) % 1000;
+        float value = next_double(seed) * 100;
+
+        id += 1 + next_random(seed) % 4;
+        memcpy(record, &id, sizeof(id));
+        memcpy(record + 4, &small, sizeof(small));
+        record[6] = (next_random(seed) % 4 == 0) ? 0x80 : 0x01;
+        memcpy(record + 8, &value, sizeof(value));
+
+        for (int j = 0; j < 16 && i < size; j++) {
+            data[i++] = record[j];
+        }
+    }
+}
+
+void generate_single(char *data, size_t size, uint64_t *seed)
+{
+    memset(data, 'a', size);
+}
+
+static corpus_t corpora[] = {
+    { "uniform", generate_uniform },
+    { "zipf", generate_zipf },
+    { "text", generate_text },
+    { "binary", generate_binary },
+    { "single", generate_single },
+};
+
+/*
+ * Measurements
+ */
+
+double now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Time and performance counters of every stage in one run.
+ */
+typedef struct measurement {
+    counters_t *counters;
+    double start;
+    double times[NUM_STAGES];
+    uint64_t counts[NUM_STAGES][NUM_COUNTERS];
+} measurement_t;
+
+void stage_begin(measurement_t *m)
+{
+    if (m->counters != NULL)
+        counters_start(m->counters);
+    m->start = now_ns();
+}
+
+void stage_end(measurement_t *m, stage_t stage)
+{
+    m->times[stage] = now_ns() - m->start;
+    if (m->counters != NULL)
+        counters_stop(m->counters, m->counts[stage]);
+}
+
+// Run every stage once and measure it, false if the round trip fails
+bool run_once(const char *data, size_t size, char *output, measurement_t *m)
+{
+    uint64_t freq[256] = { 0 };
+    int tree_size = 0;
+    int unique_letters = 0;
+    uint64_t pos = 0;
+
+    stage_begin(m);
+    huffman_count(data, size, freq);
+    stage_end(m, STAGE_HISTOGRAM);
+
+    stage_begin(m);
+    huffman_node_t *root = huffman_new_tree_counts(freq, &tree_size, &unique_letters);
+    stage_end(m, STAGE_TREE);
+
+    stage_begin(m);
+    char **index = huffman_build_index(root);
+    stage_end(m, STAGE_TABLE);
+
+    stage_begin(m);
+    bit_array_t *bits = bit_array_new(huffman_encoded_length(index, data, size));
+    huffman_encode_range(index, data, 0, size, bits, &pos);
+    stage_end(m, STAGE_ENCODE);
+
+    stage_begin(m);
+    size_t decoded = huffman_decode_range(root, bits, NULL, 0, size, output);
+    stage_end(m, STAGE_DECODE);
+
+    bit_array_free(bits);
+    huffman_free(root, index);
+
+    return decoded == size && memcmp(data, output, size) == 0;
+}
+
+void run_corpus(corpus_t *corpus, size_t size, int repetitions, counters_t *counters,
+                results_t *results)
+{
+    uint64_t seed = 0x9E3779B97F4A7C15ULL ^ size;
+    char *data = malloc(size);
+    char *output = malloc(size);
+    double *samples[NUM_STAGES];
+
+    if (data == NULL || output == NULL)
+        error(10, 0, "OUT OF MEMORY");
+
+    corpus->generate(data, size, &seed);
+
+    for (int s = 0; s < NUM_STAGES; s++) {
+        samples[s] = calloc(repetitions, sizeof(double));
+    }
+
+    // warm up caches and the allocator before measuring
+    measurement_t m = { .counters = counters };
+    uint64_t totals[NUM_STAGES][NUM_COUNTERS] = { { 0 } };
+
+    if (!run_once(data, size, output, &m))
+        error(10, 0, "ROUND TRIP FAILED FOR CORPUS %s", corpus->name);
+
+    for (int r = 0; r < repetitions; r++) {
+        run_once(data, size, output, &m);
+        for (int s = 0; s < NUM_STAGES; s++) {
+            samples[s][r] = m.times[s];
+            for (int c = 0; c < NUM_COUNTERS; c++) {
+                totals[s][c] += m.counts[s][c];
+            }
+        }
+    }
+
+    for (int s = 0; s < NUM_STAGES; s++) {
+        result_t *r = results_add(results, corpus->name, stage_names[s], size, samples[s],
+                                  repetitions);
+
+        if (r == NULL)
+            error(10, 0, "OUT OF MEMORY");
+
+        for (int c = 0; counters != NULL && c < NUM_COUNTERS; c++) {
+            if (counters_available(counters, c))
+                r->counters[c] = totals[s][c] / (double) repetitions;
+        }
+
+        printf("%-8s %10zu %-10s %10.3f %10.2f %10.3f %10.3f %10.3f\n",
+               r->corpus, r->bytes, r->stage, r->median_ns / 1e6,
+               r->bytes / (r->median_ns / 1e9) / 1e6, r->median_ns / r->bytes,
+               r->p10_ns / 1e6, r->p90_ns / 1e6);
+
+        free(samples[s]);
+    }
+
+    free(data);
+    free(output);
+}
+
+// Print a counter normalized by f, or n/a if it was not counted
+void print_ratio(double value, double f)
+{
+    if (value < 0)
+        printf(" %11s", "n/a");
+    else
+        printf(" %11.3f", value * f);
+}
+
+void print_counters(results_t *results)
+{
+    printf("\n%-8s %10s %-10s %11s %11s %11s %11s %11s %11s\n",
+           "corpus", "bytes", "stage", "cycles/B", "IPC", "brmiss/KB", "L1dmiss/KB",
+           "LLCmiss/KB", "faults/KB");
+
+    for (int i = 0; i < results->length; i++) {
+        result_t *r = &results->items[i];
+        double *c = r->counters;
+        double per_kb = 1024.0 / r->bytes;
+
+        printf("%-8s %10zu %-10s", r->corpus, r->bytes, r->stage);
+        print_ratio(c[COUNTER_CYCLES], 1.0 / r->bytes);
+
+        if (c[COUNTER_CYCLES] > 0 && c[COUNTER_INSTRUCTIONS] >= 0)
+            print_ratio(c[COUNTER_INSTRUCTIONS], 1 / c[COUNTER_CYCLES]);
+        else
+            print_ratio(-1, 0);
+
+        print_ratio(c[COUNTER_BRANCH_MISSES], per_kb);
+        print_ratio(c[COUNTER_L1D_MISSES], per_kb);
+        print_ratio(c[COUNTER_LLC_MISSES], per_kb);
+        print_ratio(c[COUNTER_PAGE_FAULTS], per_kb);
+        puts("");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct arguments arguments;
+
+    // Default values
+    arguments.repetitions = DEFAULT_REPETITIONS;
+    arguments.size = 0;
+    arguments.corpus = NULL;
+    arguments.json_file = NULL;
+    arguments.baseline_file = NULL;
+    arguments.threshold = DEFAULT_THRESHOLD;
+    arguments.counters = 0;
+
+    argp_parse(&argp, argc, argv, 0, 0, &arguments);
+
+    results_t results = { 0 };
+    results_t baseline = { 0 };
+    counters_t *counters = NULL;
+
+    if (arguments.counters) {
+        counters = counters_open();
+
+        if (counters == NULL)
+            fprintf(stderr, "Performance counters unavailable, check perf_event_paranoid\n");
+    }
+
+    // fail early rather than after a long run
+    if (arguments.baseline_file && !results_read_json(&baseline, arguments.baseline_file))
+        error(10, 0, "FAILED TO READ BASELINE FILE %s", arguments.baseline_file);
+
+    printf("%-8s %10s %-10s %10s %10s %10s %10s %10s\n",
+           "corpus", "bytes", "stage", "median_ms", "MB/s", "ns/byte", "p10_ms", "p90_ms");
+
+    for (int c = 0; c < sizeof(corpora) / sizeof(corpora[0]); c++) {
+        if (arguments.corpus != NULL && strcmp(arguments.corpus, corpora[c].name) != 0)
+            continue;
+
+        if (arguments.size != 0) {
+            run_corpus(&corpora[c], arguments.size, arguments.repetitions, counters,
+                       &results);
+            continue;
+        }
+
+        for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            run_corpus(&corpora[c], sizes[i], arguments.repetitions, counters, &results);
+        }
+    }
+
+    if (counters != NULL) {
+        print_counters(&results);
+        counters_close(counters);
+    }
+
+    if (arguments.json_file && !results_write_json(&results, arguments.json_file))
+        error(10, 0, "FAILED TO WRITE RESULTS FILE %s", arguments.json_file);
+
+    int regressions = 0;
+
+    if (arguments.baseline_file) {
+        puts("");
+        regressions = results_compare(&baseline, &results, arguments.threshold / 100);
+        printf("\n%d significant regression(s) against %s\n", regressions,
+               arguments.baseline_file);
+    }
+
+    results_free(&results);
+    results_free(&baseline);
+
+    return (regressions > 0) ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+#include <linux/perf_event.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "counters.h"
+
+struct counters {
+    int fds[NUM_COUNTERS];
+    int leader;                 /**< file descriptor read for the whole group */
+    int opened;                 /**< number of counters in the group */
+    int slot[NUM_COUNTERS];     /**< position of each counter in the group, -1 if missing */
+};
+
+/**
+ * Layout of a group read with PERF_FORMAT_GROUP and the total times.
+ */
+typedef struct group_read {
+    uint64_t count;
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t values[NUM_COUNTERS];
+} group_read_t;
+
+typedef struct event {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} event_t;
+
+#define CACHE_READ_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) \
+                                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const event_t events[NUM_COUNTERS] = {
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { "L1d-misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D) },
+    { "LLC-misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL) },
+    { "page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+
+int event_open(const event_t *event, int group)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+
+    attr.size = sizeof(attr);
+    attr.type = event->type;
+    attr.config = event->config;
+    // members follow the leader, which starts disabled
+    attr.disabled = (group < 0);
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+                       | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // user space only, allowed with the default perf_event_paranoid setting
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+counters_t *counters_open()
+{
+    counters_t *counters = calloc(1, sizeof(counters_t));
+
+    if (counters == NULL) {
+        return NULL;
+    }
+
+    counters->leader = -1;
+
+    // one group so all counters cover the same instructions when the PMU is shared
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        counters->fds[i] = event_open(&events[i], counters->leader);
+        counters->slot[i] = (counters->fds[i] >= 0) ? counters->opened++ : -1;
+
+        if (counters->fds[i] >= 0 && counters->leader < 0) {
+            counters->leader = counters->fds[i];
+        }
+    }
+
+    if (counters->opened == 0) {
+        free(counters);
+        return NULL;
+    }
+
+    return counters;
+}
+
+bool counters_available(counters_t *counters, counter_t counter)
+{
+    return counters->slot[counter] >= 0;
+}
+
+const char *counters_name(counter_t counter)
+{
+    return events[counter].name;
+}
+
+void counters_start(counters_t *counters)
+{
+    ioctl(counters->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counters->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void counters_stop(counters_t *counters, uint64_t values[NUM_COUNTERS])
+{
+    group_read_t group;
+
+    ioctl(counters->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    if (read(counters->leader, &group, sizeof(group)) < 3 * (ssize_t) sizeof(uint64_t)
+            || group.count != counters->opened) {
+        group.time_running = 0;
+    }
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        values[i] = 0;
+
+        if (counters->slot[i] < 0 || group.time_running == 0) {
+            continue;
+        }
+
+        // extrapolate to the whole run if the group shared the PMU with other users
+        values[i] = group.values[counters->slot[i]];
+        if (group.time_running < group.time_enabled) {
+            values[i] = (double) values[i] * group.time_enabled / group.time_running;
+        }
+    }
+}
+
+void counters_close(counters_t *counters)
+{
+    // closing the leader last keeps the group intact while members go away
+    for (int i = NUM_COUNTERS - 1; i >= 0; i--) {
+        if (counters->fds[i] >= 0) {
+            close(counters->fds[i]);
+        }
+    }
+
+    free(counters);
+}
@@ -0,0 +1,75 @@
+/**
+ * Hardware performance counters through Linux perf_event_open.
+ *
+ * Counters the kernel or CPU does not support are skipped, so the same
+ * binary works on bare metal, in virtual machines and in containers. The
+ * rest are read as one group so they count the same code, and are scaled
+ * up when the kernel multiplexed the group with other users.
+ * @file
+ */
+#ifndef __COUNTERS_H__
+#define __COUNTERS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Counter set type.
+ */
+typedef struct counters counters_t;
+
+/**
+ * Counted events.
+ */
+typedef enum counter {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_L1D_MISSES,
+    COUNTER_LLC_MISSES,
+    COUNTER_PAGE_FAULTS,
+    NUM_COUNTERS
+} counter_t;
+
+/**
+ * Open all counters for the calling thread.
+ * @return the counter set, NULL if no counter could be opened
+ */
+counters_t *counters_open();
+
+/**
+ * Check if a counter was opened.
+ * @param counters counter set
+ * @param counter counter to check
+ * @return true if the counter is counting
+ */
+bool counters_available(counters_t *counters, counter_t counter);
+
+/**
+ * Get a short name of a counter.
+ * @param counter counter
+ * @return name of the counter
+ */
+const char *counters_name(counter_t counter);
+
+/**
+ * Reset and start all counters.
+ * @param counters counter set
+ */
+void counters_start(counters_t *counters);
+
+/**
+ * Stop all counters and read them.
+ * Unavailable counters read as 0.
+ * @param counters counter set
+ * @param values stores the value of every counter
+ */
+void counters_stop(counters_t *counters, uint64_t values[NUM_COUNTERS]);
+
+/**
+ * Close all counters.
+ * @param counters counter set to free
+ */
+void counters_close(counters_t *counters);
+
+#endif //__COUNTERS_H__
@@ -0,0 +1,315 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "results.h"
+
+#define RESULTS_VERSION 1
+
+// scale factor from median absolute deviation to standard deviation
+#define MAD_TO_SIGMA 1.4826
+
+int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted samples
+double percentile(double *sorted, int n, double p)
+{
+    int rank = (int) ceil(p / 100 * n);
+    return sorted[(rank < 1) ? 0 : rank - 1];
+}
+
+result_t *results_push(results_t *results)
+{
+    if (results->length == results->capacity) {
+        int capacity = 2 * results->capacity + 16;
+        result_t *items = realloc(results->items, capacity * sizeof(result_t));
+
+        if (items == NULL) {
+            return NULL;
+        }
+
+        results->items = items;
+        results->capacity = capacity;
+    }
+
+    result_t *result = &results->items[results->length++];
+    memset(result, 0, sizeof(result_t));
+    return result;
+}
+
+result_t *results_add(results_t *results, const char *corpus, const char *stage, size_t bytes,
+                      double *samples, int n)
+{
+    result_t *result = results_push(results);
+
+    if (result == NULL) {
+        return NULL;
+    }
+
+    qsort(samples, n, sizeof(double), compare_doubles);
+
+    snprintf(result->corpus, sizeof(result->corpus), "%s", corpus);
+    snprintf(result->stage, sizeof(result->stage), "%s", stage);
+    result->bytes = bytes;
+    result->repetitions = n;
+    result->median_ns = percentile(samples, n, 50);
+    result->p10_ns = percentile(samples, n, 10);
+    result->p90_ns = percentile(samples, n, 90);
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        result->counters[i] = -1;
+    }
+
+    double *deviations = malloc(n * sizeof(double));
+
+    if (deviations != NULL) {
+        for (int i = 0; i < n; i++) {
+            deviations[i] = fabs(samples[i] - result->median_ns);
+        }
+
+        qsort(deviations, n, sizeof(double), compare_doubles);
+        result->mad_ns = percentile(deviations, n, 50);
+        free(deviations);
+    }
+
+    return result;
+}
+
+bool results_write_json(results_t *results, const char *path)
+{
+    FILE *file = (strcmp(path, "-") == 0) ? stdout : fopen(path, "w");
+
+    if (file == NULL) {
+        return false;
+    }
+
+    fprintf(file, "{\n  \"version\": %d,\n  \"results\": [", RESULTS_VERSION);
+
+    for (int i = 0; i < results->length; i++) {
+        result_t *r = &results->items[i];
+
+        fprintf(file, "%s\n    {\"corpus\": \"%s\", \"stage\": \"%s\", \"bytes\": %zu, "
+                "\"repetitions\": %d, \"median_ns\": %.0f, \"mad_ns\": %.0f, "
+                "\"p10_ns\": %.0f, \"p90_ns\": %.0f, \"mb_per_s\": %.3f, \"ns_per_byte\": %.4f",
+                (i > 0) ? "," : "", r->corpus, r->stage, r->bytes, r->repetitions,
+                r->median_ns, r->mad_ns, r->p10_ns, r->p90_ns,
+                r->bytes / (r->median_ns / 1e9) / 1e6, r->median_ns / r->bytes);
+
+        for (int c = 0; c < NUM_COUNTERS; c++) {
+            if (r->counters[c] >= 0) {
+                fprintf(file, ", \"%s\": %.0f", counters_name(c), r->counters[c]);
+            }
+        }
+
+        fprintf(file, "}");
+    }
+
+    fprintf(file, "\n  ]\n}\n");
+
+    bool ok = !ferror(file);
+
+    if (file != stdout) {
+        ok &= fclose(file) == 0;
+    }
+
+    return ok;
+}
+
+char *read_file(const char *path)
+{
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL) {
+        return NULL;
+    }
+
+    fseek(file, 0L, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+
+    char *text = malloc(size + 1);
+
+    if (text != NULL) {
+        size = fread(text, 1, size, file);
+        text[size] = '\0';
+    }
+
+    fclose(file);
+    return text;
+}
+
+// Parse a quoted string at *p into buf, false if *p is not a string
+bool parse_string(char **p, char *buf, size_t size)
+{
+    if (**p != '"') {
+        return false;
+    }
+
+    size_t n = 0;
+    char *c = *p + 1;
+
+    while (*c != '\0' && *c != '"') {
+        if (n + 1 < size) {
+            buf[n++] = *c;
+        }
+
+        c++;
+    }
+
+    buf[n] = '\0';
+    *p = (*c == '"') ? c + 1 : c;
+    return true;
+}
+
+// Parse one flat object of the results array, the only JSON this program writes
+bool parse_result(char **p, result_t *result)
+{
+    char key[32];
+    char value[32];
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        result->counters[i] = -1;
+    }
+
+    (*p)++;
+
+    for (;;) {
+        while (isspace(**p) || **p == ',') (*p)++;
+
+        if (**p == '}') {
+            (*p)++;
+            return true;
+        }
+
+        if (!parse_string(p, key, sizeof(key))) {
+            return false;
+        }
+
+        while (isspace(**p) || **p == ':') (*p)++;
+
+        if (**p == '"') {
+            parse_string(p, value, sizeof(value));
+
+            if (strcmp(key, "corpus") == 0) {
+                snprintf(result->corpus, sizeof(result->corpus), "%s", value);
+            } else if (strcmp(key, "stage") == 0) {
+                snprintf(result->stage, sizeof(result->stage), "%s", value);
+            }
+        } else {
+            char *end;
+            double number = strtod(*p, &end);
+
+            if (end == *p) {
+                return false;
+            }
+
+            *p = end;
+
+            if (strcmp(key, "bytes") == 0) {
+                result->bytes = number;
+            } else if (strcmp(key, "repetitions") == 0) {
+                result->repetitions = number;
+            } else if (strcmp(key, "median_ns") == 0) {
+                result->median_ns = number;
+            } else if (strcmp(key, "mad_ns") == 0) {
+                result->mad_ns = number;
+            } else if (strcmp(key, "p10_ns") == 0) {
+                result->p10_ns = number;
+            } else if (strcmp(key, "p90_ns") == 0) {
+                result->p90_ns = number;
+            }
+
+            for (int i = 0; i < NUM_COUNTERS; i++) {
+                if (strcmp(key, counters_name(i)) == 0) {
+                    result->counters[i] = number;
+                }
+            }
+        }
+    }
+}
+
+bool results_read_json(results_t *results, const char *path)
+{
+    char *text = read_file(path);
+
+    if (text == NULL) {
+        return false;
+    }
+
+    char *p = strstr(text, "\"results\"");
+    p = (p != NULL) ? strchr(p, '[') : NULL;
+    bool ok = p != NULL;
+
+    while (ok && (p = strpbrk(p, "{]")) != NULL && *p == '{') {
+        result_t *result = results_push(results);
+        ok = result != NULL && parse_result(&p, result);
+    }
+
+    free(text);
+    return ok;
+}
+
+result_t *results_find(results_t *results, result_t *key)
+{
+    for (int i = 0; i < results->length; i++) {
+        result_t *r = &results->items[i];
+
+        if (r->bytes == key->bytes && strcmp(r->corpus, key->corpus) == 0
+                && strcmp(r->stage, key->stage) == 0) {
+            return r;
+        }
+    }
+
+    return NULL;
+}
+
+int results_compare(results_t *baseline, results_t *current, double threshold)
+{
+    int regressions = 0;
+
+    printf("%-8s %10s %-10s %12s %12s %9s %9s  %s\n",
+           "corpus", "bytes", "stage", "base_ms", "current_ms", "change", "noise", "status");
+
+    for (int i = 0; i < current->length; i++) {
+        result_t *cur = &current->items[i];
+        result_t *base = results_find(baseline, cur);
+
+        if (base == NULL || base->median_ns <= 0) {
+            printf("%-8s %10zu %-10s %12s %12.3f %9s %9s  %s\n", cur->corpus, cur->bytes,
+                   cur->stage, "-", cur->median_ns / 1e6, "-", "-", "new");
+            continue;
+        }
+
+        double change = cur->median_ns / base->median_ns - 1;
+        double sigma = MAD_TO_SIGMA * hypot(base->mad_ns, cur->mad_ns);
+        double noise = 3 * sigma / base->median_ns;
+        const char *status = "ok";
+
+        if (change > threshold && change > noise) {
+            status = "SLOWER";
+            regressions++;
+        } else if (-change > threshold && -change > noise) {
+            status = "faster";
+        }
+
+        printf("%-8s %10zu %-10s %12.3f %12.3f %+8.1f%% %8.1f%%  %s\n", cur->corpus,
+               cur->bytes, cur->stage, base->median_ns / 1e6, cur->median_ns / 1e6,
+               100 * change, 100 * noise, status);
+    }
+
+    return regressions;
+}
+
+void results_free(results_t *results)
+{
+    free(results->items);
+    results->items = NULL;
+    results->length = 0;
+    results->capacity = 0;
+}
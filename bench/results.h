@@ -0,0 +1,83 @@
+/**
+ * Benchmark results, JSON serialization and baseline comparison.
+ * @file
+ */
+#ifndef __RESULTS_H__
+#define __RESULTS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "counters.h"
+
+/**
+ * Summary of the repetitions of one stage on one corpus.
+ */
+typedef struct result {
+    char corpus[32];
+    char stage[32];
+    size_t bytes;
+    int repetitions;
+    double median_ns;
+    double mad_ns;      /**< median absolute deviation */
+    double p10_ns;
+    double p90_ns;
+    double counters[NUM_COUNTERS];  /**< mean per repetition, negative if not counted */
+} result_t;
+
+/**
+ * Growable list of results.
+ */
+typedef struct results {
+    result_t *items;
+    int length;
+    int capacity;
+} results_t;
+
+/**
+ * Summarize samples into a result and append it.
+ * @param results list to append to
+ * @param corpus corpus name
+ * @param stage stage name
+ * @param bytes corpus size
+ * @param samples time of each repetition in ns, sorted in place
+ * @param n number of samples
+ * @return the appended result
+ */
+result_t *results_add(results_t *results, const char *corpus, const char *stage, size_t bytes,
+                      double *samples, int n);
+
+/**
+ * Write results as JSON.
+ * @param results results to write
+ * @param path output file, "-" for stdout
+ * @return true on success
+ */
+bool results_write_json(results_t *results, const char *path);
+
+/**
+ * Load results written by results_write_json().
+ * @param results list to append to
+ * @param path file to read
+ * @return true on success
+ */
+bool results_read_json(results_t *results, const char *path);
+
+/**
+ * Compare results with a baseline and print a report.
+ * A stage regresses when its median is slower than the baseline by more
+ * than both threshold and three standard deviations of the combined noise,
+ * estimated from the median absolute deviation of each run.
+ * @param baseline reference results
+ * @param current new results
+ * @param threshold minimum relative slowdown to report, e.g. 0.05
+ * @return number of significant regressions
+ */
+int results_compare(results_t *baseline, results_t *current, double threshold);
+
+/**
+ * Free memory allocated by the list.
+ * @param results list to free
+ */
+void results_free(results_t *results);
+
+#endif //__RESULTS_H__
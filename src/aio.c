@@ -0,0 +1,570 @@
+#include <assert.h>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "aio.h"
+#include "memory.h"
+
+#define AIO_MAX_THREADS 4
+
+typedef struct request request_t;
+typedef struct uring uring_t;
+typedef struct pool pool_t;
+
+enum { OP_READ, OP_WRITE };
+
+/**
+ * A single read or write, occupying one queue slot while in flight.
+ */
+struct request {
+    bool busy;
+    int op;
+    int fd;
+    uint8_t *buf;
+    size_t length;
+    off_t offset;
+    size_t done;        /**< bytes transferred so far */
+    ssize_t result;     /**< final result, set by the thread backend */
+    struct iovec iov;   /**< io_uring reads the iovec after submission */
+    void *data;
+};
+
+/**
+ * Rings shared with the kernel.
+ */
+struct uring {
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr;
+    void *cq_ptr;
+    size_t sq_size;
+    size_t cq_size;
+    size_t sqes_size;
+    int error;          /**< errno of a failed wait, after which the ring is dead */
+};
+
+/**
+ * Thread pool with FIFO queues of slot indexes.
+ */
+struct pool {
+    pthread_t threads[AIO_MAX_THREADS];
+    int num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t submitted;
+    pthread_cond_t completed;
+    int *todo;
+    int todo_head;
+    int todo_length;
+    int *done;
+    int done_head;
+    int done_length;
+    bool stop;
+};
+
+struct aio {
+    aio_backend_t backend;
+    int depth;
+    int pending;
+    request_t *requests;
+    uring_t uring;
+    pool_t pool;
+};
+
+/*
+ * io_uring backend
+ */
+
+static int uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int fd, unsigned submit, unsigned wait, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+
+static bool uring_init(uring_t *ring, int depth)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ring->fd = uring_setup(depth, &params);
+
+    if (ring->fd < 0) {
+        return false;
+    }
+
+    ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+    if (single_mmap) {
+        if (ring->cq_size > ring->sq_size) {
+            ring->sq_size = ring->cq_size;
+        }
+
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_ptr = ring->sq_ptr;
+
+    if (!single_mmap && ring->sq_ptr != MAP_FAILED) {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    }
+
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+
+    if (ring->sq_ptr == MAP_FAILED || ring->cq_ptr == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        if (ring->sq_ptr != MAP_FAILED) munmap(ring->sq_ptr, ring->sq_size);
+        if (!single_mmap && ring->cq_ptr != MAP_FAILED) munmap(ring->cq_ptr, ring->cq_size);
+        if (ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+        close(ring->fd);
+        return false;
+    }
+
+    uint8_t *sq = ring->sq_ptr;
+    uint8_t *cq = ring->cq_ptr;
+
+    ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+    ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+    return true;
+}
+
+static bool uring_submit(uring_t *ring, request_t *req, int slot)
+{
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    req->iov.iov_base = req->buf + req->done;
+    req->iov.iov_len = req->length - req->done;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (req->op == OP_READ) ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = req->fd;
+    sqe->addr = (uintptr_t) &req->iov;
+    sqe->len = 1;
+    sqe->off = req->offset + req->done;
+    sqe->user_data = slot;
+
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    int submitted;
+    while ((submitted = uring_enter(ring->fd, 1, 0, 0)) < 0 && errno == EINTR)
+        ;
+
+    if (submitted > 0) {
+        return true;
+    }
+
+    if (submitted == 0) {
+        errno = EAGAIN;
+    }
+
+    /*
+     * The kernel only consumes entries inside io_uring_enter(), so a failed
+     * call left ours in the ring. Take it back so a later call doesn't
+     * submit it once the slot and its buffer have been reused.
+     */
+    int error = errno;
+    if (__atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) == tail) {
+        __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+    }
+    errno = error;
+
+    return false;
+}
+
+// Hand back a request in flight as failed, the ring being dead
+static ssize_t uring_fail(aio_t *aio, void **data)
+{
+    int slot = 0;
+
+    while (!aio->requests[slot].busy) {
+        slot++;
+    }
+
+    request_t *req = &aio->requests[slot];
+    req->busy = false;
+    req->result = -aio->uring.error;
+    aio->pending--;
+    *data = req->data;
+    return req->result;
+}
+
+static ssize_t uring_wait(aio_t *aio, void **data)
+{
+    uring_t *ring = &aio->uring;
+
+    for (;;) {
+        unsigned head = *ring->cq_head;
+
+        if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            /*
+             * Completions can no longer be collected once entering the ring
+             * fails for good, so give every request back with the error
+             * rather than leave callers draining the queue forever.
+             */
+            if (ring->error == 0 && uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0
+                    && errno != EINTR) {
+                ring->error = errno;
+            }
+
+            if (ring->error != 0) {
+                return uring_fail(aio, data);
+            }
+
+            continue;
+        }
+
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        int slot = cqe->user_data;
+        int res = cqe->res;
+        __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+        request_t *req = &aio->requests[slot];
+
+        if (res < 0 && res != -EINTR && res != -EAGAIN) {
+            req->done = 0;
+            req->result = res;
+        } else {
+            if (res > 0) {
+                req->done += res;
+            }
+
+            // resubmit the remainder of short transfers, except reads at end of file
+            bool eof = req->op == OP_READ && res == 0;
+
+            if (!eof && req->done < req->length) {
+                if (uring_submit(ring, req, slot)) {
+                    continue;
+                }
+
+                req->result = -errno;
+            } else {
+                req->result = req->done;
+            }
+        }
+
+        req->busy = false;
+        aio->pending--;
+        *data = req->data;
+        return req->result;
+    }
+}
+
+static void uring_free(uring_t *ring)
+{
+    munmap(ring->sqes, ring->sqes_size);
+
+    if (ring->cq_ptr != ring->sq_ptr) {
+        munmap(ring->cq_ptr, ring->cq_size);
+    }
+
+    munmap(ring->sq_ptr, ring->sq_size);
+    close(ring->fd);
+}
+
+/*
+ * Thread pool backend
+ */
+
+static ssize_t request_run(request_t *req)
+{
+    while (req->done < req->length) {
+        ssize_t n;
+
+        if (req->op == OP_READ) {
+            n = pread(req->fd, req->buf + req->done, req->length - req->done,
+                      req->offset + req->done);
+        } else {
+            n = pwrite(req->fd, req->buf + req->done, req->length - req->done,
+                       req->offset + req->done);
+        }
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+
+        if (n == 0) {
+            break;
+        }
+
+        req->done += n;
+    }
+
+    return req->done;
+}
+
+static void *pool_worker(void *arg)
+{
+    aio_t *aio = arg;
+    pool_t *pool = &aio->pool;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (;;) {
+        while (pool->todo_length == 0 && !pool->stop) {
+            pthread_cond_wait(&pool->submitted, &pool->lock);
+        }
+
+        if (pool->todo_length == 0) {
+            break;
+        }
+
+        int slot = pool->todo[pool->todo_head];
+        pool->todo_head = (pool->todo_head + 1) % aio->depth;
+        pool->todo_length--;
+
+        pthread_mutex_unlock(&pool->lock);
+        aio->requests[slot].result = request_run(&aio->requests[slot]);
+        pthread_mutex_lock(&pool->lock);
+
+        pool->done[(pool->done_head + pool->done_length) % aio->depth] = slot;
+        pool->done_length++;
+        pthread_cond_signal(&pool->completed);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+static bool pool_init(aio_t *aio)
+{
+    pool_t *pool = &aio->pool;
+
+    pool->todo = memory_calloc(MEMORY_AIO, aio->depth, sizeof(int));
+    pool->done = memory_calloc(MEMORY_AIO, aio->depth, sizeof(int));
+
+    if (pool->todo == NULL || pool->done == NULL) {
+        memory_free(MEMORY_AIO, pool->todo);
+        memory_free(MEMORY_AIO, pool->done);
+        return false;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->submitted, NULL);
+    pthread_cond_init(&pool->completed, NULL);
+
+    int num_threads = (aio->depth < AIO_MAX_THREADS) ? aio->depth : AIO_MAX_THREADS;
+
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, aio) != 0) {
+            break;
+        }
+
+        pool->num_threads++;
+    }
+
+    if (pool->num_threads == 0) {
+        pthread_mutex_destroy(&pool->lock);
+        pthread_cond_destroy(&pool->submitted);
+        pthread_cond_destroy(&pool->completed);
+        memory_free(MEMORY_AIO, pool->todo);
+        memory_free(MEMORY_AIO, pool->done);
+        return false;
+    }
+
+    return true;
+}
+
+static void pool_submit(pool_t *pool, int depth, int slot)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->todo[(pool->todo_head + pool->todo_length) % depth] = slot;
+    pool->todo_length++;
+    pthread_cond_signal(&pool->submitted);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static ssize_t pool_wait(aio_t *aio, void **data)
+{
+    pool_t *pool = &aio->pool;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (pool->done_length == 0) {
+        pthread_cond_wait(&pool->completed, &pool->lock);
+    }
+
+    int slot = pool->done[pool->done_head];
+    pool->done_head = (pool->done_head + 1) % aio->depth;
+    pool->done_length--;
+
+    pthread_mutex_unlock(&pool->lock);
+
+    request_t *req = &aio->requests[slot];
+    req->busy = false;
+    aio->pending--;
+    *data = req->data;
+    return req->result;
+}
+
+static void pool_free(pool_t *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->submitted);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->submitted);
+    pthread_cond_destroy(&pool->completed);
+    memory_free(MEMORY_AIO, pool->todo);
+    memory_free(MEMORY_AIO, pool->done);
+}
+
+/*
+ * Public interface
+ */
+
+aio_t *aio_new(aio_backend_t backend, int depth)
+{
+    assert(depth > 0);
+
+    aio_t *aio = memory_calloc(MEMORY_AIO, 1, sizeof(aio_t));
+
+    if (aio == NULL) {
+        return NULL;
+    }
+
+    aio->depth = depth;
+    aio->requests = memory_calloc(MEMORY_AIO, depth, sizeof(request_t));
+
+    if (aio->requests == NULL) {
+        memory_free(MEMORY_AIO, aio);
+        return NULL;
+    }
+
+    if (backend != AIO_THREADS && uring_init(&aio->uring, depth)) {
+        aio->backend = AIO_URING;
+    } else if (backend != AIO_URING && pool_init(aio)) {
+        aio->backend = AIO_THREADS;
+    } else {
+        memory_free(MEMORY_AIO, aio->requests);
+        memory_free(MEMORY_AIO, aio);
+        return NULL;
+    }
+
+    return aio;
+}
+
+const char *aio_backend_name(aio_t *aio)
+{
+    return (aio->backend == AIO_URING) ? "io_uring" : "threads";
+}
+
+static bool aio_submit(aio_t *aio, int op, int fd, void *buf, size_t length, off_t offset,
+                       void *data)
+{
+    if (aio->pending >= aio->depth) {
+        return false;
+    }
+
+    int slot = 0;
+
+    while (aio->requests[slot].busy) {
+        slot++;
+    }
+
+    request_t *req = &aio->requests[slot];
+    memset(req, 0, sizeof(request_t));
+    req->busy = true;
+    req->op = op;
+    req->fd = fd;
+    req->buf = buf;
+    req->length = length;
+    req->offset = offset;
+    req->data = data;
+
+    if (aio->backend == AIO_URING) {
+        if (!uring_submit(&aio->uring, req, slot)) {
+            req->busy = false;
+            return false;
+        }
+    } else {
+        pool_submit(&aio->pool, aio->depth, slot);
+    }
+
+    aio->pending++;
+    return true;
+}
+
+bool aio_read(aio_t *aio, int fd, void *buf, size_t length, off_t offset, void *data)
+{
+    return aio_submit(aio, OP_READ, fd, buf, length, offset, data);
+}
+
+bool aio_write(aio_t *aio, int fd, const void *buf, size_t length, off_t offset, void *data)
+{
+    return aio_submit(aio, OP_WRITE, fd, (void *) buf, length, offset, data);
+}
+
+int aio_pending(aio_t *aio)
+{
+    return aio->pending;
+}
+
+ssize_t aio_wait(aio_t *aio, void **data)
+{
+    assert(aio->pending > 0);
+
+    if (aio->backend == AIO_URING) {
+        return uring_wait(aio, data);
+    } else {
+        return pool_wait(aio, data);
+    }
+}
+
+void aio_free(aio_t *aio)
+{
+    void *data;
+
+    while (aio->pending > 0) {
+        aio_wait(aio, &data);
+    }
+
+    if (aio->backend == AIO_URING) {
+        uring_free(&aio->uring);
+    } else {
+        pool_free(&aio->pool);
+    }
+
+    memory_free(MEMORY_AIO, aio->requests);
+    memory_free(MEMORY_AIO, aio);
+}
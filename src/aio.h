@@ -0,0 +1,93 @@
+/**
+ * Asynchronous file I/O queue.
+ *
+ * Keeps several positional reads and writes in flight at once so disk I/O
+ * can overlap with encoding and decoding. Requests are served by io_uring
+ * when the kernel supports it, otherwise by a small pool of threads doing
+ * blocking pread/pwrite calls.
+ * @file
+ */
+#ifndef __AIO_H__
+#define __AIO_H__
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/**
+ * Asynchronous I/O queue type.
+ */
+typedef struct aio aio_t;
+
+/**
+ * Backend used to serve requests.
+ */
+typedef enum aio_backend {
+    AIO_AUTO,    /**< io_uring if available, threads otherwise */
+    AIO_URING,   /**< io_uring only */
+    AIO_THREADS  /**< pread/pwrite thread pool */
+} aio_backend_t;
+
+/**
+ * Create a new I/O queue.
+ * @param backend backend to use
+ * @param depth maximum number of requests in flight
+ * @return the new queue, NULL if the backend is unavailable
+ */
+aio_t *aio_new(aio_backend_t backend, int depth);
+
+/**
+ * Get the name of the backend serving the queue.
+ * @param aio queue to check
+ * @return "io_uring" or "threads"
+ */
+const char *aio_backend_name(aio_t *aio);
+
+/**
+ * Queue a read of length bytes at offset into buf.
+ * The buffer must stay valid until the request is returned by aio_wait().
+ * @param aio queue to submit to
+ * @param fd file to read from
+ * @param buf destination buffer
+ * @param length number of bytes to read
+ * @param offset file offset to read from
+ * @param data user pointer returned by aio_wait()
+ * @return false if the queue is full
+ */
+bool aio_read(aio_t *aio, int fd, void *buf, size_t length, off_t offset, void *data);
+
+/**
+ * Queue a write of length bytes from buf at offset.
+ * The buffer must stay valid until the request is returned by aio_wait().
+ * @param aio queue to submit to
+ * @param fd file to write to
+ * @param buf source buffer
+ * @param length number of bytes to write
+ * @param offset file offset to write at
+ * @param data user pointer returned by aio_wait()
+ * @return false if the queue is full
+ */
+bool aio_write(aio_t *aio, int fd, const void *buf, size_t length, off_t offset, void *data);
+
+/**
+ * Get the number of requests in flight.
+ * @param aio queue to check
+ * @return number of submitted requests not yet returned by aio_wait()
+ */
+int aio_pending(aio_t *aio);
+
+/**
+ * Wait for any request to complete.
+ * Reads shorter than requested have reached end of file.
+ * @param aio queue to wait on, must have pending requests
+ * @param data stores the user pointer of the completed request
+ * @return number of bytes transferred, or a negative errno value
+ */
+ssize_t aio_wait(aio_t *aio, void **data);
+
+/**
+ * Free the queue. Pending requests are waited for and discarded.
+ * @param aio queue to free
+ */
+void aio_free(aio_t *aio);
+
+#endif //__AIO_H__
@@ -1,110 +1,489 @@
+#include <endian.h>
+#include <errno.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "bit_array.h"
+#include "iter.h"
+#include "memory.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #define BYTE_SIZE 8
+#define WORD_SIZE 64
+#define WORD_BYTES (WORD_SIZE / BYTE_SIZE)
+
+// longest array whose word count can be computed without overflowing
+#define MAX_BIT_LENGTH (UINT64_MAX - (WORD_SIZE - 1))
+
+// size of the little-endian length in front of serialized arrays
+#define HEADER_BYTES 8
+#define LEGACY_HEADER_BYTES 4
 
+/*
+ * Bits are stored as little-endian 64-bit words, which puts bit n in byte
+ * n / 8 at position n % 8. Owned storage is padded with one extra word so
+ * a whole word can always be loaded at any byte inside the array; borrowed
+ * storage has no padding and its last bytes are accessed one at a time.
+ */
 struct bit_array {
-    unsigned int bit_length;
-    unsigned int length;
+    uint64_t bit_length;
+    uint64_t length;    /**< bytes holding the bits */
+    uint64_t size;      /**< bytes that may be accessed */
     uint8_t *data;
+    bool borrowed;
+    void *map;              /**< mapping unmapped by bit_array_free() */
+    size_t map_length;
 };
 
-bit_array_t *bit_array_new(unsigned int length)
+bit_array_t *bit_array_new(uint64_t length)
 {
-    unsigned int array_length = (length + BYTE_SIZE - 1) / BYTE_SIZE;
-    bit_array_t *array = calloc(1, sizeof(bit_array_t));
+    if (length > MAX_BIT_LENGTH)
+        return NULL;
+
+    uint64_t array_length = (length + BYTE_SIZE - 1) / BYTE_SIZE;
+    uint64_t words = (length + WORD_SIZE - 1) / WORD_SIZE + 1;
+    bit_array_t *array = memory_calloc(MEMORY_BIT_ARRAY, 1, sizeof(bit_array_t));
 
     if (array != NULL) {
-        array->data = calloc(array_length, sizeof(uint8_t));
+        array->data = memory_calloc(MEMORY_BIT_ARRAY, words, WORD_BYTES);
+        if (array->data == NULL) {
+            memory_free(MEMORY_BIT_ARRAY, array);
+            return NULL;
+        }
+
         array->bit_length = length;
         array->length = array_length;
+        array->size = words * WORD_BYTES;
     }
 
     return array;
 }
 
-unsigned int bit_array_length(bit_array_t *array)
+bit_array_t *bit_array_wrap(uint8_t *data, uint64_t length)
+{
+    if (length > MAX_BIT_LENGTH)
+        return NULL;
+
+    bit_array_t *array = memory_calloc(MEMORY_BIT_ARRAY, 1, sizeof(bit_array_t));
+
+    if (array != NULL) {
+        array->data = data;
+        array->bit_length = length;
+        array->length = (length + BYTE_SIZE - 1) / BYTE_SIZE;
+        array->size = array->length;
+        array->borrowed = true;
+    }
+
+    return array;
+}
+
+uint64_t bit_array_length(bit_array_t *array)
 {
     return array->bit_length;
 }
 
-unsigned int bit_index(bit_array_t *array, unsigned int n)
+static inline uint64_t low_mask(int count)
 {
-    return n / BYTE_SIZE;
+    return (count >= WORD_SIZE) ? ~(uint64_t) 0 : ((uint64_t) 1 << count) - 1;
 }
 
-unsigned int bit_pos(bit_array_t *array, unsigned int n)
+// Load the word starting at a byte, reading past the storage as zeros
+static inline uint64_t load_word(bit_array_t *array, uint64_t byte)
 {
-    return n % BYTE_SIZE;
+    uint64_t word = 0;
+
+    if (byte + WORD_BYTES <= array->size) {
+        memcpy(&word, array->data + byte, WORD_BYTES);
+        return le64toh(word);
+    }
+
+    for (uint64_t i = 0; byte + i < array->size; i++) {
+        word |= (uint64_t) array->data[byte + i] << (i * BYTE_SIZE);
+    }
+
+    return word;
+}
+
+// Store the word starting at a byte, dropping bytes past the storage
+static inline void store_word(bit_array_t *array, uint64_t byte, uint64_t word)
+{
+    if (byte + WORD_BYTES <= array->size) {
+        word = htole64(word);
+        memcpy(array->data + byte, &word, WORD_BYTES);
+        return;
+    }
+
+    for (uint64_t i = 0; byte + i < array->size; i++) {
+        array->data[byte + i] = word >> (i * BYTE_SIZE);
+    }
 }
 
-void bit_array_set(bit_array_t *array, unsigned int n)
+void bit_array_set(bit_array_t *array, uint64_t n)
 {
-    unsigned int i = bit_index(array, n);
-    unsigned int pos = bit_pos(array, n);
-    array->data[i] |= (1 << pos);
+    array->data[n / BYTE_SIZE] |= (1 << (n % BYTE_SIZE));
 }
 
-bool bit_array_unset(bit_array_t *array, unsigned int n)
+bool bit_array_unset(bit_array_t *array, uint64_t n)
 {
-    unsigned int i = bit_index(array, n);
-    unsigned int pos = bit_pos(array, n);
-    array->data[i] &= ~(1 << pos);
+    array->data[n / BYTE_SIZE] &= ~(1 << (n % BYTE_SIZE));
     return true;
 }
 
-void bit_array_toggle(bit_array_t *array, unsigned int n)
+void bit_array_toggle(bit_array_t *array, uint64_t n)
+{
+    array->data[n / BYTE_SIZE] ^= (1 << (n % BYTE_SIZE));
+}
+
+bool bit_array_test(bit_array_t *array, uint64_t n)
 {
-    unsigned int i = bit_index(array, n);
-    unsigned int pos = bit_pos(array, n);
-    array->data[i] ^= (1 << pos);
+    return (array->data[n / BYTE_SIZE] & (1 << (n % BYTE_SIZE))) != 0;
 }
 
-bool bit_array_test(bit_array_t *array, unsigned int n)
+uint64_t bit_array_peek(bit_array_t *array, uint64_t pos, int count)
 {
-    unsigned int i = bit_index(array, n);
-    unsigned int pos = bit_pos(array, n);
-    return (array->data[i] & (1 << pos)) != 0;
+    uint64_t byte = pos / BYTE_SIZE;
+    int shift = pos % BYTE_SIZE;
+    uint64_t value = load_word(array, byte) >> shift;
+
+    // the field spills into the byte after the loaded word
+    if (shift + count > WORD_SIZE && byte + WORD_BYTES < array->size)
+        value |= (uint64_t) array->data[byte + WORD_BYTES] << (WORD_SIZE - shift);
+
+    return value & low_mask(count);
+}
+
+uint64_t bit_array_get(bit_array_t *array, uint64_t *pos, int count)
+{
+    uint64_t value = bit_array_peek(array, *pos, count);
+    *pos += count;
+    return value;
+}
+
+void bit_array_put(bit_array_t *array, uint64_t pos, uint64_t value, int count)
+{
+    uint64_t byte = pos / BYTE_SIZE;
+    int shift = pos % BYTE_SIZE;
+    uint64_t mask = low_mask(count);
+
+    value &= mask;
+    store_word(array, byte, (load_word(array, byte) & ~(mask << shift)) | (value << shift));
+
+    if (shift + count > WORD_SIZE && byte + WORD_BYTES < array->size) {
+        uint8_t *last = &array->data[byte + WORD_BYTES];
+        *last = (*last & ~(mask >> (WORD_SIZE - shift))) | (value >> (WORD_SIZE - shift));
+    }
+}
+
+// Make room for length bits, growing geometrically for amortized appends
+static bool reserve(bit_array_t *array, uint64_t length)
+{
+    if (length > MAX_BIT_LENGTH)
+        return false;
+
+    uint64_t needed = ((length + WORD_SIZE - 1) / WORD_SIZE + 1) * WORD_BYTES;
+
+    if (array->borrowed)
+        return (length + BYTE_SIZE - 1) / BYTE_SIZE <= array->size;
+
+    if (needed <= array->size)
+        return true;
+
+    uint64_t size = (2 * array->size > needed) ? 2 * array->size : needed;
+    uint8_t *data = memory_realloc(MEMORY_BIT_ARRAY, array->data, size);
+
+    if (data == NULL)
+        return false;
+
+    memset(data + array->size, 0, size - array->size);
+    array->data = data;
+    array->size = size;
+
+    return true;
+}
+
+static void set_length(bit_array_t *array, uint64_t length)
+{
+    array->bit_length = length;
+    array->length = (length + BYTE_SIZE - 1) / BYTE_SIZE;
+}
+
+// Clear the bits from start up to end
+static void clear_range(bit_array_t *array, uint64_t start, uint64_t end)
+{
+    for (uint64_t pos = start; pos < end; pos += WORD_SIZE) {
+        bit_array_put(array, pos, 0, (end - pos < WORD_SIZE) ? end - pos : WORD_SIZE);
+    }
+}
+
+bool bit_array_resize(bit_array_t *array, uint64_t length)
+{
+    uint64_t old_length = array->bit_length;
+
+    if (!reserve(array, length))
+        return false;
+
+    set_length(array, length);
+
+    if (length > old_length)
+        clear_range(array, old_length, length);
+
+    return true;
 }
 
-int bit_array_count(bit_array_t *array)
+bool bit_array_append(bit_array_t *array, uint64_t *pos, uint64_t value, int count)
 {
-    int n;
-    int count = 0;
+    if (*pos > MAX_BIT_LENGTH - count)
+        return false;
+
+    if (*pos + count > array->bit_length) {
+        uint64_t old_length = array->bit_length;
+
+        if (!reserve(array, *pos + count))
+            return false;
+
+        set_length(array, *pos + count);
 
-    for (int i = 0; i < array->length; i++) {
-        n = array->data[i];
+        // the appended bits are overwritten below, only a gap needs clearing
+        if (*pos > old_length)
+            clear_range(array, old_length, *pos);
+    }
+
+    bit_array_put(array, *pos, value, count);
+    *pos += count;
+    return true;
+}
 
-        while (n) {
-            count += n & 1;
-            n = n >> 1;
+void bit_array_copy(bit_array_t *dest, uint64_t dest_pos,
+                    bit_array_t *src, uint64_t src_pos, uint64_t count)
+{
+    // copy backwards when the ranges overlap with the destination after the source
+    if (dest == src && dest_pos > src_pos && dest_pos < src_pos + count) {
+        while (count > 0) {
+            int n = (count < WORD_SIZE) ? count : WORD_SIZE;
+            count -= n;
+            bit_array_put(dest, dest_pos + count, bit_array_peek(src, src_pos + count, n), n);
         }
+        return;
+    }
+
+    for (uint64_t done = 0; done < count; done += WORD_SIZE) {
+        int n = (count - done < WORD_SIZE) ? count - done : WORD_SIZE;
+        bit_array_put(dest, dest_pos + done, bit_array_peek(src, src_pos + done, n), n);
+    }
+}
+
+// Count the set bits in whole bytes, one word at a time
+static inline uint64_t count_bytes_words(const uint8_t *data, uint64_t bytes)
+{
+    uint64_t count = 0;
+    uint64_t i = 0;
+
+    for (; i + WORD_BYTES <= bytes; i += WORD_BYTES) {
+        uint64_t word;
+        memcpy(&word, data + i, WORD_BYTES);
+        count += __builtin_popcountll(word);
+    }
+
+    for (; i < bytes; i++) {
+        count += __builtin_popcount(data[i]);
     }
 
     return count;
 }
 
-void bit_array_fill(bit_array_t *array)
+static uint64_t count_bytes_generic(const uint8_t *data, uint64_t bytes)
+{
+    return count_bytes_words(data, bytes);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("popcnt")))
+static uint64_t count_bytes_popcnt(const uint8_t *data, uint64_t bytes)
+{
+    return count_bytes_words(data, bytes);
+}
+
+// Count 32 bytes at a time by looking up the bit count of each nibble
+__attribute__((target("avx2")))
+static uint64_t count_bytes_avx2(const uint8_t *data, uint64_t bytes)
 {
-    for (int i = 0; i < array->length; i++) {
-        array->data[i] = ~0;
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i total = _mm256_setzero_si256();
+    uint64_t i = 0;
+
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (data + i));
+        __m256i lo = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, nibble));
+        __m256i hi = _mm256_shuffle_epi8(lookup,
+                                         _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(lo, hi),
+                                                        _mm256_setzero_si256()));
     }
+
+    uint64_t count = _mm256_extract_epi64(total, 0) + _mm256_extract_epi64(total, 1) +
+                     _mm256_extract_epi64(total, 2) + _mm256_extract_epi64(total, 3);
+
+    return count + count_bytes_popcnt(data + i, bytes - i);
+}
+
+#endif
+
+// Implementation picked for the running CPU
+static uint64_t (*count_bytes)(const uint8_t *data, uint64_t bytes) = count_bytes_generic;
+
+__attribute__((constructor))
+static void bit_array_dispatch()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+        count_bytes = count_bytes_avx2;
+    else if (__builtin_cpu_supports("popcnt"))
+        count_bytes = count_bytes_popcnt;
+#endif
+}
+
+uint64_t bit_array_count(bit_array_t *array)
+{
+    uint64_t bytes = array->bit_length / BYTE_SIZE;
+    int rest = array->bit_length % BYTE_SIZE;
+    uint64_t count = count_bytes(array->data, bytes);
+
+    if (rest > 0)
+        count += __builtin_popcount(array->data[bytes] & ((1 << rest) - 1));
+
+    return count;
+}
+
+// Zero the bits of the last byte that are past the end of the array
+static void clear_tail(bit_array_t *array)
+{
+    int rest = array->bit_length % BYTE_SIZE;
+
+    if (rest > 0)
+        array->data[array->length - 1] &= (1 << rest) - 1;
+}
+
+void bit_array_fill(bit_array_t *array)
+{
+    memset(array->data, 0xff, array->length);
+    clear_tail(array);
 }
 
 void bit_array_clear(bit_array_t *array)
 {
-    for (int i = 0; i < array->length; i++) {
-        array->data[i] &= 0;
+    memset(array->data, 0, array->length);
+}
+
+/*
+ * Combine src into dest a word at a time. The loop is expanded once per
+ * operator so the compiler sees a branch-free body it can vectorize.
+ */
+#define BITWISE_LOOP(dest, src, op)                                 \
+    do {                                                            \
+        uint64_t i = 0;                                             \
+        for (; i + WORD_BYTES <= (dest)->length; i += WORD_BYTES) { \
+            uint64_t a, b;                                          \
+            memcpy(&a, (dest)->data + i, WORD_BYTES);               \
+            memcpy(&b, (src)->data + i, WORD_BYTES);                \
+            a = a op b;                                             \
+            memcpy((dest)->data + i, &a, WORD_BYTES);               \
+        }                                                           \
+        for (; i < (dest)->length; i++) {                           \
+            (dest)->data[i] = (dest)->data[i] op (src)->data[i];    \
+        }                                                           \
+    } while (0)
+
+bool bit_array_and(bit_array_t *dest, bit_array_t *src)
+{
+    if (dest->bit_length != src->bit_length)
+        return false;
+
+    BITWISE_LOOP(dest, src, &);
+    return true;
+}
+
+bool bit_array_or(bit_array_t *dest, bit_array_t *src)
+{
+    if (dest->bit_length != src->bit_length)
+        return false;
+
+    BITWISE_LOOP(dest, src, |);
+    clear_tail(dest);
+    return true;
+}
+
+bool bit_array_xor(bit_array_t *dest, bit_array_t *src)
+{
+    if (dest->bit_length != src->bit_length)
+        return false;
+
+    BITWISE_LOOP(dest, src, ^);
+    clear_tail(dest);
+    return true;
+}
+
+void bit_array_not(bit_array_t *array)
+{
+    uint64_t i = 0;
+
+    for (; i + WORD_BYTES <= array->length; i += WORD_BYTES) {
+        uint64_t word;
+        memcpy(&word, array->data + i, WORD_BYTES);
+        word = ~word;
+        memcpy(array->data + i, &word, WORD_BYTES);
     }
+
+    for (; i < array->length; i++) {
+        array->data[i] = ~array->data[i];
+    }
+
+    clear_tail(array);
+}
+
+void bit_array_shift_left(bit_array_t *array, uint64_t n)
+{
+    if (n >= array->bit_length) {
+        bit_array_clear(array);
+        return;
+    }
+
+    bit_array_copy(array, n, array, 0, array->bit_length - n);
+    clear_range(array, 0, n);
+}
+
+void bit_array_shift_right(bit_array_t *array, uint64_t n)
+{
+    if (n >= array->bit_length) {
+        bit_array_clear(array);
+        return;
+    }
+
+    bit_array_copy(array, 0, array, n, array->bit_length - n);
+    clear_range(array, array->bit_length - n, array->bit_length);
+}
+
+uint8_t *bit_array_data(bit_array_t *array)
+{
+    return array->data;
 }
 
 void bit_array_print(bit_array_t *array)
 {
-    int pos = 0;
-    for (int i = 0; i < array->length; i++) {
+    uint64_t pos = 0;
+    for (uint64_t i = 0; i < array->length; i++) {
         for (int j = 0; j < BYTE_SIZE; j++) {
             printf("%d", (array->data[i] & (1 << j)) != 0);
             if (++pos >= array->bit_length) return;
@@ -112,26 +491,292 @@ void bit_array_print(bit_array_t *array)
     }
 }
 
-bit_array_t *bit_array_read(FILE *file)
+// Load the word of bits starting at a multiple of the word size
+static inline uint64_t word_at(bit_array_t *array, uint64_t base)
+{
+    uint64_t left = array->bit_length - base;
+    return bit_array_peek(array, base, (left < WORD_SIZE) ? left : WORD_SIZE);
+}
+
+bool bit_array_find_set(bit_array_t *array, uint64_t from, uint64_t *pos)
+{
+    if (from >= array->bit_length)
+        return false;
+
+    uint64_t base = from - from % WORD_SIZE;
+    uint64_t word = word_at(array, base) & (~(uint64_t) 0 << (from % WORD_SIZE));
+
+    // skip zero words, then the trailing zeros of the first non-zero one
+    while (word == 0) {
+        base += WORD_SIZE;
+        if (base >= array->bit_length)
+            return false;
+        word = word_at(array, base);
+    }
+
+    *pos = base + __builtin_ctzll(word);
+    return true;
+}
+
+uint64_t bit_array_find_set_batch(bit_array_t *array, uint64_t *from,
+                                  uint64_t *positions, uint64_t max)
+{
+    uint64_t count = 0;
+
+    if (*from >= array->bit_length || max == 0)
+        return 0;
+
+    uint64_t base = *from - *from % WORD_SIZE;
+    uint64_t word = word_at(array, base) & (~(uint64_t) 0 << (*from % WORD_SIZE));
+
+    while (true) {
+        while (word != 0) {
+            positions[count++] = base + __builtin_ctzll(word);
+            word &= word - 1;
+
+            if (count == max) {
+                *from = positions[count - 1] + 1;
+                return count;
+            }
+        }
+
+        base += WORD_SIZE;
+        if (base >= array->bit_length)
+            break;
+        word = word_at(array, base);
+    }
+
+    *from = array->bit_length;
+    return count;
+}
+
+/**
+ * Position of an iterator over the set bits.
+ */
+typedef struct bit_array_cursor {
+    bit_array_t *array;
+    uint64_t pos;       /**< set bit the cursor is at */
+    uint64_t value;     /**< position handed out by the iterator */
+} bit_array_cursor_t;
+
+void bit_array_iter_restart(void *c)
+{
+    bit_array_cursor_t *cursor = c;
+
+    if (!bit_array_find_set(cursor->array, 0, &cursor->pos))
+        cursor->pos = cursor->array->bit_length;
+}
+
+void *bit_array_iter_value(void *c)
+{
+    bit_array_cursor_t *cursor = c;
+
+    if (cursor->pos >= cursor->array->bit_length)
+        return NULL;
+
+    // hand out a copy so stepping does not change the returned value
+    cursor->value = cursor->pos;
+    return &cursor->value;
+}
+
+void *bit_array_iter_next(void *c)
+{
+    bit_array_cursor_t *cursor = c;
+
+    if (!bit_array_find_set(cursor->array, cursor->pos + 1, &cursor->pos))
+        cursor->pos = cursor->array->bit_length;
+
+    return c;
+}
+
+void bit_array_iter_free(void *c)
+{
+    memory_free(MEMORY_BIT_ARRAY, c);
+}
+
+iter_t *iter_bit_array(bit_array_t *array)
+{
+    if (array == NULL) {
+        return NULL;
+    }
+
+    bit_array_cursor_t *cursor = memory_malloc(MEMORY_BIT_ARRAY, sizeof(bit_array_cursor_t));
+
+    if (cursor == NULL) {
+        return NULL;
+    }
+
+    cursor->array = array;
+    bit_array_iter_restart(cursor);
+
+    return iter_new_cursor(cursor, bit_array_iter_value, bit_array_iter_next,
+                           bit_array_iter_restart, bit_array_iter_free);
+}
+
+// Decode a length field of header_size bytes
+static uint64_t header_length(const uint8_t *header, int header_size)
 {
-    unsigned int length;
-    fread(&length, sizeof(length), 1, file);
+    uint64_t length = 0;
+
+    for (int i = 0; i < header_size; i++) {
+        length |= (uint64_t) header[i] << (i * BYTE_SIZE);
+    }
+
+    return length;
+}
+
+static bit_array_t *map_array(int fd, off_t *offset, bool copy_on_write, int header_size)
+{
+    struct stat st;
+    uint8_t header[HEADER_BYTES];
+
+    if (*offset < 0 || fstat(fd, &st) < 0 || st.st_size - *offset < header_size)
+        return NULL;
+
+    if (pread(fd, header, header_size, *offset) != header_size)
+        return NULL;
+
+    uint64_t length = header_length(header, header_size);
+    if (length > MAX_BIT_LENGTH)
+        return NULL;
+
+    uint64_t bytes = (length + BYTE_SIZE - 1) / BYTE_SIZE;
+    if ((uint64_t) (st.st_size - *offset) - header_size < bytes)
+        return NULL;
+
+    // mappings have to start on a page boundary
+    off_t start = *offset - *offset % sysconf(_SC_PAGESIZE);
+    size_t skip = *offset - start + header_size;
+
+    if (bytes > SIZE_MAX - skip)
+        return NULL;
+
+    bit_array_t *array = memory_calloc(MEMORY_BIT_ARRAY, 1, sizeof(bit_array_t));
+    if (array == NULL)
+        return NULL;
+
+    array->map_length = skip + bytes;
+    array->map = mmap(NULL, array->map_length,
+                      copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ,
+                      MAP_PRIVATE, fd, start);
+
+    if (array->map == MAP_FAILED) {
+        memory_free(MEMORY_BIT_ARRAY, array);
+        return NULL;
+    }
+
+    array->data = (uint8_t *) array->map + skip;
+    array->bit_length = length;
+    array->length = bytes;
+    array->size = bytes;
+    array->borrowed = true;
+
+    *offset += header_size + bytes;
+
+    return array;
+}
+
+bit_array_t *bit_array_map(int fd, off_t *offset, bool copy_on_write)
+{
+    return map_array(fd, offset, copy_on_write, HEADER_BYTES);
+}
+
+bit_array_t *bit_array_map_legacy(int fd, off_t *offset, bool copy_on_write)
+{
+    return map_array(fd, offset, copy_on_write, LEGACY_HEADER_BYTES);
+}
+
+bool bit_array_store(bit_array_t *array, int fd, off_t *offset)
+{
+    uint64_t header = htole64(array->bit_length);
+    const uint8_t *parts[2] = { (const uint8_t *) &header, array->data };
+    uint64_t sizes[2] = { sizeof(header), array->length };
+    off_t pos = *offset;
+
+    // write straight from the array, retrying partial writes
+    for (int i = 0; i < 2; i++) {
+        uint64_t done = 0;
+
+        while (done < sizes[i]) {
+            uint64_t chunk = sizes[i] - done;
+            ssize_t written = pwrite(fd, parts[i] + done, chunk < SSIZE_MAX ? chunk : SSIZE_MAX,
+                                     pos);
+
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+
+            done += written;
+            pos += written;
+        }
+    }
+
+    *offset = pos;
+
+    return true;
+}
+
+static bit_array_t *read_array(FILE *file, int header_size)
+{
+    uint8_t header[HEADER_BYTES];
+
+    if (fread(header, header_size, 1, file) != 1)
+        return NULL;
+
+    uint64_t length = header_length(header, header_size);
+    if (length > MAX_BIT_LENGTH)
+        return NULL;
+
+    // don't allocate more than a seekable stream can still hold
+    uint64_t bytes = (length + BYTE_SIZE - 1) / BYTE_SIZE;
+    off_t pos = ftello(file);
+
+    if (pos >= 0 && fseeko(file, 0, SEEK_END) == 0) {
+        off_t end = ftello(file);
+
+        if (fseeko(file, pos, SEEK_SET) != 0 || end < pos || (uint64_t) (end - pos) < bytes)
+            return NULL;
+    }
 
     bit_array_t *array = bit_array_new(length);
 
-    fread(array->data, sizeof(array->data[0]), array->length, file);
+    if (array == NULL)
+        return NULL;
+
+    if (fread(array->data, 1, array->length, file) != array->length) {
+        bit_array_free(array);
+        return NULL;
+    }
+
+    clear_tail(array);
 
     return array;
 }
 
-void bit_array_write(bit_array_t *array, FILE *file)
+bit_array_t *bit_array_read(FILE *file)
+{
+    return read_array(file, HEADER_BYTES);
+}
+
+bit_array_t *bit_array_read_legacy(FILE *file)
 {
-    fwrite(&array->bit_length, sizeof(array->bit_length), 1, file);
-    fwrite(array->data, sizeof(array->data[0]), array->length, file);
+    return read_array(file, LEGACY_HEADER_BYTES);
+}
+
+bool bit_array_write(bit_array_t *array, FILE *file)
+{
+    uint64_t length = htole64(array->bit_length);
+
+    return fwrite(&length, sizeof(length), 1, file) == 1 &&
+           fwrite(array->data, 1, array->length, file) == array->length;
 }
 
 void bit_array_free(bit_array_t *array)
 {
-    free(array->data);
-    free(array);
+    if (array->map != NULL)
+        munmap(array->map, array->map_length);
+    else if (!array->borrowed)
+        memory_free(MEMORY_BIT_ARRAY, array->data);
+    memory_free(MEMORY_BIT_ARRAY, array);
 }
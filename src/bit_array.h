@@ -2,29 +2,42 @@
 #define __BIT_ARRAY_H__
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include "iter.h"
 
 typedef struct bit_array bit_array_t;
 
 /**
  * Create a new bit array.
+ * @param length length in bits, at most 2^64 - 64
+ * @return new bit array, NULL on failure
+ */
+bit_array_t *bit_array_new(uint64_t length);
+
+/**
+ * Wrap existing storage in a bit array without copying it.
+ * The storage is not freed by bit_array_free() and must outlive the array.
+ * @param data storage laid out as described by bit_array_data()
  * @param length length in bits
  * @return new bit array
  */
-bit_array_t *bit_array_new(unsigned int length);
+bit_array_t *bit_array_wrap(uint8_t *data, uint64_t length);
 
 /**
  * Get the length (in bits) of the bit array.
  * @param array bit array to check
  * @return length in bits
  */
-unsigned int bit_array_length(bit_array_t *array);
+uint64_t bit_array_length(bit_array_t *array);
 
 /**
  * Set bit to 1 at index.
  * @param array bit array
  * @param n bit index
  */
-void bit_array_set(bit_array_t *array, unsigned int n);
+void bit_array_set(bit_array_t *array, uint64_t n);
 
 /**
  * Set bit to 0 at index.
@@ -32,14 +45,14 @@ void bit_array_set(bit_array_t *array, unsigned int n);
  * @param n bit index
  * @return true if bit was changed
  */
-bool bit_array_unset(bit_array_t *array, unsigned int n);
+bool bit_array_unset(bit_array_t *array, uint64_t n);
 
 /**
  * Toggle bit at index.
  * @param array bit array
  * @param n bit index
  */
-void bit_array_toggle(bit_array_t *array, unsigned int n);
+void bit_array_toggle(bit_array_t *array, uint64_t n);
 
 /**
  * Test if bit at position n is 1.
@@ -47,14 +60,76 @@ void bit_array_toggle(bit_array_t *array, unsigned int n);
  * @param n bit index
  * @return true if bit at position n is 1
  */
-bool bit_array_test(bit_array_t *array, unsigned int n);
+bool bit_array_test(bit_array_t *array, uint64_t n);
+
+/**
+ * Read up to 64 bits starting at a position without moving it.
+ * The bit at pos becomes the least significant bit of the result.
+ * @param array bit array to read
+ * @param pos index of the first bit
+ * @param count number of bits, 1 to 64
+ * @return the bits, zero past the end of the array
+ */
+uint64_t bit_array_peek(bit_array_t *array, uint64_t pos, int count);
+
+/**
+ * Read up to 64 bits at *pos and advance *pos past them.
+ * @param array bit array to read
+ * @param pos index of the first bit, advanced by count
+ * @param count number of bits, 1 to 64
+ * @return the bits, least significant bit first
+ */
+uint64_t bit_array_get(bit_array_t *array, uint64_t *pos, int count);
+
+/**
+ * Overwrite up to 64 bits starting at a position.
+ * The least significant bit of value is stored at pos.
+ * @param array bit array to write
+ * @param pos index of the first bit
+ * @param value bits to store, bits above count are ignored
+ * @param count number of bits, 1 to 64
+ */
+void bit_array_put(bit_array_t *array, uint64_t pos, uint64_t value, int count);
+
+/**
+ * Write up to 64 bits at *pos and advance *pos past them.
+ * The array grows when the bits end past its length.
+ * @param array bit array to write
+ * @param pos index of the first bit, advanced by count
+ * @param value bits to store, least significant bit first
+ * @param count number of bits, 1 to 64
+ * @return false if the array could not grow
+ */
+bool bit_array_append(bit_array_t *array, uint64_t *pos, uint64_t value, int count);
+
+/**
+ * Change the length of the array. Bits past the old length read as 0, and
+ * storage grows by doubling so arrays built with bit_array_append() need
+ * not be sized up front. Borrowed storage cannot grow.
+ * @param array bit array to resize
+ * @param length new length in bits
+ * @return false if the storage could not grow
+ */
+bool bit_array_resize(bit_array_t *array, uint64_t length);
+
+/**
+ * Copy a range of bits between arrays, or within one array.
+ * @param dest array to copy to
+ * @param dest_pos index of the first bit to overwrite
+ * @param src array to copy from
+ * @param src_pos index of the first bit to copy
+ * @param count number of bits to copy
+ */
+void bit_array_copy(bit_array_t *dest, uint64_t dest_pos,
+                    bit_array_t *src, uint64_t src_pos, uint64_t count);
 
 /**
  * Count number of set bits in array.
+ * Uses AVX2 or the popcount instruction when the CPU has them.
  * @param array bit array to count
  * @return number of bits set to 1 in array
  */
-int bit_array_count(bit_array_t *array);
+uint64_t bit_array_count(bit_array_t *array);
 
 /**
  * Fill bit array with 1's.
@@ -68,10 +143,155 @@ void bit_array_fill(bit_array_t *array);
  */
 void bit_array_clear(bit_array_t *array);
 
+/**
+ * Keep only the bits set in both arrays: dest &= src.
+ * @param dest array to update
+ * @param src array of the same length
+ * @return false if the lengths differ
+ */
+bool bit_array_and(bit_array_t *dest, bit_array_t *src);
+
+/**
+ * Set the bits set in either array: dest |= src.
+ * @param dest array to update
+ * @param src array of the same length
+ * @return false if the lengths differ
+ */
+bool bit_array_or(bit_array_t *dest, bit_array_t *src);
+
+/**
+ * Set the bits set in exactly one array: dest ^= src.
+ * @param dest array to update
+ * @param src array of the same length
+ * @return false if the lengths differ
+ */
+bool bit_array_xor(bit_array_t *dest, bit_array_t *src);
+
+/**
+ * Invert every bit of the array.
+ * @param array array to update
+ */
+void bit_array_not(bit_array_t *array);
+
+/**
+ * Move every bit n positions towards the end of the array.
+ * Bits moved past the end are dropped and the first n bits become 0.
+ * @param array array to update
+ * @param n number of positions
+ */
+void bit_array_shift_left(bit_array_t *array, uint64_t n);
+
+/**
+ * Move every bit n positions towards the start of the array.
+ * Bits moved before the start are dropped and the last n bits become 0.
+ * @param array array to update
+ * @param n number of positions
+ */
+void bit_array_shift_right(bit_array_t *array, uint64_t n);
+
+/**
+ * Get the underlying storage of the bit array.
+ * The pointer changes when the array grows.
+ * Bits are stored in little-endian 64-bit words, so bit n is in byte
+ * n / 8 at position n % 8. The storage need not be word aligned.
+ * @param array bit array
+ * @return pointer to the first byte
+ */
+uint8_t *bit_array_data(bit_array_t *array);
+
+/**
+ * Find the first set bit at or after a position.
+ * Whole words of zeros are skipped at once.
+ * @param array bit array to search
+ * @param from position to start at
+ * @param pos stores the position of the set bit
+ * @return false if no bit is set from there to the end
+ */
+bool bit_array_find_set(bit_array_t *array, uint64_t from, uint64_t *pos);
+
+/**
+ * Collect the positions of the set bits at or after *from.
+ * @param array bit array to search
+ * @param from position to start at, advanced past the last bit returned
+ * @param positions stores the positions in increasing order
+ * @param max size of positions
+ * @return number of positions stored, less than max when the end is reached
+ */
+uint64_t bit_array_find_set_batch(bit_array_t *array, uint64_t *from,
+                                  uint64_t *positions, uint64_t max);
+
+/**
+ * Helper function to create an iterator over the positions of set bits.
+ * Each value is a uint64_t pointer that is valid until the iterator is
+ * used again. Every iterator has its own position, so several can walk
+ * the same array at once.
+ * @param array bit array to iterate over
+ * @see iter_new_cursor()
+ * @return Iterator
+ */
+iter_t *iter_bit_array(bit_array_t *array);
+
 void bit_array_print(bit_array_t *array);
 
+/*
+ * Serialized bit arrays are a little-endian uint64 length in bits followed
+ * by the bytes described by bit_array_data().
+ */
+
+/**
+ * Map a serialized bit array from a file without reading it. The mapping
+ * is private, so the file never changes; with copy_on_write the array can
+ * be modified in memory, otherwise it is read-only and must not be
+ * written to. Mapped arrays cannot grow. The file descriptor may be closed
+ * once the array is mapped.
+ * @param fd file to map
+ * @param offset position of the array in the file, advanced past it
+ * @param copy_on_write make the mapping writable
+ * @return new bit array, NULL if the file is too short or cannot be mapped
+ */
+bit_array_t *bit_array_map(int fd, off_t *offset, bool copy_on_write);
+
+/**
+ * Map a bit array serialized with a 32-bit length, the layout used before
+ * lengths were widened to 64 bits. See bit_array_map().
+ * @param fd file to map
+ * @param offset position of the array in the file, advanced past it
+ * @param copy_on_write make the mapping writable
+ * @return new bit array, NULL if the file is too short or cannot be mapped
+ */
+bit_array_t *bit_array_map_legacy(int fd, off_t *offset, bool copy_on_write);
+
+/**
+ * Serialize a bit array to a file, writing directly from its storage.
+ * @param array bit array to write
+ * @param fd file to write to
+ * @param offset position to write at, advanced past the array
+ * @return false if the write failed
+ */
+bool bit_array_store(bit_array_t *array, int fd, off_t *offset);
+
+/**
+ * Read a serialized bit array into memory.
+ * @param file file to read from
+ * @return new bit array, NULL if the length is invalid or the file too short
+ */
 bit_array_t *bit_array_read(FILE *file);
-void bit_array_write(bit_array_t *array, FILE *file);
+
+/**
+ * Read a bit array serialized with a 32-bit length, the layout used before
+ * lengths were widened to 64 bits.
+ * @param file file to read from
+ * @return new bit array, NULL if the file is too short
+ */
+bit_array_t *bit_array_read_legacy(FILE *file);
+
+/**
+ * Serialize a bit array to a stream.
+ * @param array bit array to write
+ * @param file file to write to
+ * @return false if the write failed
+ */
+bool bit_array_write(bit_array_t *array, FILE *file);
 
 /**
  * Free memory allocated by the bit array.
@@ -0,0 +1,163 @@
+#include <stdlib.h>
+#include "bit_index.h"
+#include "memory.h"
+
+#define WORD_SIZE 64
+#define BLOCK_WORDS 8
+#define SUPERBLOCK_WORDS 64
+#define BLOCKS_PER_SUPERBLOCK (SUPERBLOCK_WORDS / BLOCK_WORDS)
+
+// one select sample is kept for every this many ones
+#define SELECT_SAMPLE 4096
+
+struct bit_index {
+    bit_array_t *array;
+    uint64_t length;
+    uint64_t words;
+    uint64_t ones;
+    uint64_t *superblocks;  /**< ones before each superblock */
+    uint16_t *blocks;       /**< ones before each block, within its superblock */
+    uint64_t *samples;      /**< superblock holding every SELECT_SAMPLE-th one */
+    uint64_t num_samples;
+};
+
+// Load a word of the array, without the bits past its end
+static inline uint64_t index_word(bit_index_t *index, uint64_t w)
+{
+    uint64_t left = index->length - w * WORD_SIZE;
+    return bit_array_peek(index->array, w * WORD_SIZE, (left < WORD_SIZE) ? left : WORD_SIZE);
+}
+
+bit_index_t *bit_index_new(bit_array_t *array)
+{
+    bit_index_t *index = memory_calloc(MEMORY_BIT_INDEX, 1, sizeof(bit_index_t));
+
+    if (index == NULL)
+        return NULL;
+
+    index->array = array;
+    index->length = bit_array_length(array);
+    index->words = (index->length + WORD_SIZE - 1) / WORD_SIZE;
+
+    uint64_t num_blocks = (index->words + BLOCK_WORDS - 1) / BLOCK_WORDS;
+    uint64_t num_superblocks = (index->words + SUPERBLOCK_WORDS - 1) / SUPERBLOCK_WORDS;
+
+    index->superblocks = memory_calloc(MEMORY_BIT_INDEX, num_superblocks + 1, sizeof(uint64_t));
+    index->blocks = memory_calloc(MEMORY_BIT_INDEX, num_blocks + 1, sizeof(uint16_t));
+
+    if (index->superblocks == NULL || index->blocks == NULL) {
+        bit_index_free(index);
+        return NULL;
+    }
+
+    uint64_t ones = 0;
+    for (uint64_t w = 0; w < index->words; w++) {
+        uint64_t superblock = w / SUPERBLOCK_WORDS;
+
+        if (w % SUPERBLOCK_WORDS == 0)
+            index->superblocks[superblock] = ones;
+        if (w % BLOCK_WORDS == 0)
+            index->blocks[w / BLOCK_WORDS] = ones - index->superblocks[superblock];
+
+        ones += __builtin_popcountll(index_word(index, w));
+    }
+
+    index->ones = ones;
+    index->superblocks[num_superblocks] = ones;
+
+    // sized by the ones rather than the length, so sparse arrays need few samples
+    index->samples = memory_calloc(MEMORY_BIT_INDEX, ones / SELECT_SAMPLE + 1, sizeof(uint64_t));
+    if (index->samples == NULL) {
+        bit_index_free(index);
+        return NULL;
+    }
+
+    // sample the superblock of every one whose rank is a multiple of the interval
+    for (uint64_t superblock = 0; superblock < num_superblocks; superblock++) {
+        while (index->num_samples * SELECT_SAMPLE < index->superblocks[superblock + 1])
+            index->samples[index->num_samples++] = superblock;
+    }
+
+    return index;
+}
+
+uint64_t bit_index_ones(bit_index_t *index)
+{
+    return index->ones;
+}
+
+uint64_t bit_index_rank(bit_index_t *index, uint64_t pos)
+{
+    if (pos >= index->length)
+        return index->ones;
+
+    uint64_t w = pos / WORD_SIZE;
+    uint64_t block = w / BLOCK_WORDS;
+    uint64_t rank = index->superblocks[w / SUPERBLOCK_WORDS] + index->blocks[block];
+
+    for (uint64_t i = block * BLOCK_WORDS; i < w; i++) {
+        rank += __builtin_popcountll(index_word(index, i));
+    }
+
+    uint64_t mask = ((uint64_t) 1 << (pos % WORD_SIZE)) - 1;
+    return rank + __builtin_popcountll(index_word(index, w) & mask);
+}
+
+bool bit_index_select(bit_index_t *index, uint64_t k, uint64_t *pos)
+{
+    if (k >= index->ones)
+        return false;
+
+    // the samples bound the superblocks that can hold the one
+    uint64_t sample = k / SELECT_SAMPLE;
+    uint64_t lo = index->samples[sample];
+    uint64_t hi = (sample + 1 < index->num_samples) ? index->samples[sample + 1]
+                                                    : (index->words - 1) / SUPERBLOCK_WORDS;
+
+    // last superblock with fewer than k + 1 ones before it
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo + 1) / 2;
+        if (index->superblocks[mid] <= k)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    uint64_t rest = k - index->superblocks[lo];
+    uint64_t block = lo * BLOCKS_PER_SUPERBLOCK;
+    uint64_t num_blocks = (index->words + BLOCK_WORDS - 1) / BLOCK_WORDS;
+
+    while (block + 1 < num_blocks && (block + 1) % BLOCKS_PER_SUPERBLOCK != 0 &&
+           index->blocks[block + 1] <= rest) {
+        block++;
+    }
+
+    rest -= index->blocks[block];
+
+    for (uint64_t w = block * BLOCK_WORDS; w < index->words; w++) {
+        uint64_t word = index_word(index, w);
+        uint64_t count = __builtin_popcountll(word);
+
+        if (rest < count) {
+            // drop the lower ones until the wanted one is the lowest
+            for (; rest > 0; rest--) {
+                word &= word - 1;
+            }
+
+            *pos = w * WORD_SIZE + __builtin_ctzll(word);
+            return true;
+        }
+
+        rest -= count;
+    }
+
+    return false;
+}
+
+void bit_index_free(bit_index_t *index)
+{
+    memory_free(MEMORY_BIT_INDEX, index->superblocks);
+    memory_free(MEMORY_BIT_INDEX, index->blocks);
+    memory_free(MEMORY_BIT_INDEX, index->samples);
+    memory_free(MEMORY_BIT_INDEX, index);
+}
@@ -0,0 +1,62 @@
+/**
+ * Rank and select index over a bit array.
+ *
+ * The index stores the number of ones before every 4096-bit superblock
+ * and, relative to it, before every 512-bit block, which is about 4.7% of
+ * the array's size, plus the superblock of every 4096th one for select,
+ * which adds up to 1.6% more when all bits are set. Rank then needs at
+ * most eight popcounts and select a short search between sampled
+ * superblocks. The index describes the array as it was when the index was
+ * built and must be rebuilt after changes.
+ * @file
+ */
+#ifndef __BIT_INDEX_H__
+#define __BIT_INDEX_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bit_array.h"
+
+/**
+ * Rank and select index type.
+ */
+typedef struct bit_index bit_index_t;
+
+/**
+ * Build an index over a bit array.
+ * @param array array to index, must outlive the index
+ * @return the new index, NULL on failure
+ */
+bit_index_t *bit_index_new(bit_array_t *array);
+
+/**
+ * Get the number of set bits in the indexed array.
+ * @param index index to check
+ * @return number of ones
+ */
+uint64_t bit_index_ones(bit_index_t *index);
+
+/**
+ * Count the set bits before a position.
+ * @param index index to query
+ * @param pos bit position, positions past the end count every bit
+ * @return number of ones in [0, pos)
+ */
+uint64_t bit_index_rank(bit_index_t *index, uint64_t pos);
+
+/**
+ * Find the position of a set bit by its rank.
+ * @param index index to query
+ * @param k number of ones before the bit to find, starting at 0
+ * @param pos stores the position of the bit
+ * @return false if the array has k or fewer ones
+ */
+bool bit_index_select(bit_index_t *index, uint64_t k, uint64_t *pos);
+
+/**
+ * Free the index. The indexed array is not freed.
+ * @param index index to free
+ */
+void bit_index_free(bit_index_t *index);
+
+#endif //__BIT_INDEX_H__
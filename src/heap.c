@@ -3,35 +3,66 @@
 #include <stdio.h>
 #include <string.h>
 #include "heap.h"
+#include "memory.h"
 
+#define HEAP_INITIAL_CAPACITY 16
+
+typedef struct heap_entry {
+    void *value;
+    heap_handle_t handle;
+} heap_entry_t;
+
+/*
+ * Every value gets a handle when it is inserted. positions maps a handle to
+ * the index of its entry, and the handles of removed values are chained
+ * into a free list through positions as -2 - next free handle.
+ */
 struct heap {
     int capacity;
     int size;
+    int arity;
+    int order;      /**< 1 for max-heaps, -1 for min-heaps, 0 for custom heapify */
     heap_compare_func cmp;
     heap_heapify_func heapify;
-    void **array;
+    heap_entry_t *array;
+    int *positions;
+    int handles;        /**< handles handed out so far */
+    int free_handle;    /**< first free handle, -1 if none */
 };
 
-// forward declarations
-bool max_heapify(heap_t *heap, int index);
-bool min_heapify(heap_t *heap, int index);
-int heap_find(heap_t *heap, void *value);
-
-heap_t *heap_new(int capacity, heap_compare_func cmp, heap_heapify_func heapify)
+heap_t *heap_new_arity(int capacity, int arity, heap_compare_func cmp, heap_heapify_func heapify)
 {
-    heap_t *heap = calloc(1, sizeof(heap_t));
+    heap_t *heap = memory_calloc(MEMORY_HEAP, 1, sizeof(heap_t));
 
     if (heap != NULL) {
-        heap->capacity = capacity;
+        heap->capacity = (capacity > 0) ? capacity : HEAP_INITIAL_CAPACITY;
         heap->size = 0;
+        heap->arity = (arity >= 2) ? arity : 2;
         heap->cmp = cmp;
         heap->heapify = heapify;
-        heap->array = calloc(capacity, sizeof(void*));
+        heap->array = memory_calloc(MEMORY_HEAP, heap->capacity, sizeof(heap_entry_t));
+        heap->positions = memory_calloc(MEMORY_HEAP, heap->capacity, sizeof(int));
+        heap->free_handle = -1;
+
+        if (heapify == max_heapify)
+            heap->order = 1;
+        else if (heapify == min_heapify)
+            heap->order = -1;
+
+        if (heap->array == NULL || heap->positions == NULL) {
+            heap_free(heap);
+            return NULL;
+        }
     }
 
     return heap;
 }
 
+heap_t *heap_new(int capacity, heap_compare_func cmp, heap_heapify_func heapify)
+{
+    return heap_new_arity(capacity, 2, cmp, heapify);
+}
+
 heap_t *heap_new_max(int capacity, heap_compare_func cmp)
 {
     return heap_new(capacity, cmp, max_heapify);
@@ -47,117 +78,249 @@ int heap_size(heap_t *heap)
     return heap->size;
 }
 
-int heap_parent(int index)
+int heap_arity(heap_t *heap)
 {
-    return (index - 1) / 2;
+    return heap->arity;
 }
 
-int heap_left(int index)
+int heap_parent(heap_t *heap, int index)
 {
-    return 2*index + 1;
+    return (index - 1) / heap->arity;
 }
 
-int heap_right(int index)
+int heap_child(heap_t *heap, int index)
 {
-    return 2*index + 2;
+    return heap->arity * index + 1;
 }
 
-bool max_heapify(heap_t *heap, int index)
+static inline void heap_place(heap_t *heap, int index, heap_entry_t entry)
+{
+    heap->array[index] = entry;
+    heap->positions[entry.handle] = index;
+}
+
+// Move an entry down until no child belongs above it, order being 1 or -1
+static bool sift_down(heap_t *heap, int index, int order)
 {
-    int largest;
-    int left = heap_left(index);
-    int right = heap_right(index);
+    heap_entry_t entry = heap->array[index];
+    bool moved = false;
 
-    if (left < heap->size && heap->cmp(heap_get(heap, left), heap_get(heap, index)) > 0) {
-        largest = left;
-    } else {
-        largest = index;
+    for (;;) {
+        int first = heap_child(heap, index);
+
+        if (first >= heap->size)
+            break;
+
+        int last = (first + heap->arity < heap->size) ? first + heap->arity : heap->size;
+        int best = first;
+
+        for (int child = first + 1; child < last; child++) {
+            if (order * heap->cmp(heap->array[child].value, heap->array[best].value) > 0)
+                best = child;
+        }
+
+        if (order * heap->cmp(heap->array[best].value, entry.value) <= 0)
+            break;
+
+        heap_place(heap, index, heap->array[best]);
+        index = best;
+        moved = true;
+    }
+
+    heap_place(heap, index, entry);
+
+    return moved;
+}
+
+// Move an entry up until its parent belongs above it, order being 1 or -1
+static bool sift_up(heap_t *heap, int index, int order)
+{
+    heap_entry_t entry = heap->array[index];
+    bool moved = false;
+
+    while (index > 0) {
+        int parent = heap_parent(heap, index);
+
+        if (order * heap->cmp(entry.value, heap->array[parent].value) <= 0)
+            break;
+
+        heap_place(heap, index, heap->array[parent]);
+        index = parent;
+        moved = true;
     }
 
-    if (right < heap->size && heap->cmp(heap_get(heap, right), heap_get(heap, largest)) > 0) {
-        largest = right;
+    heap_place(heap, index, entry);
+
+    return moved;
+}
+
+// Restore the heap after the entry at index changed
+static void heap_fix(heap_t *heap, int index)
+{
+    if (heap->order != 0) {
+        if (!sift_up(heap, index, heap->order))
+            sift_down(heap, index, heap->order);
+        return;
     }
 
-    if (largest != index) {
-        void **temp = heap->array[index];
-        heap->array[index] = heap->array[largest];
-        heap->array[largest] = temp;
-        heap->heapify(heap, largest);
-        return true;
+    // only the heapify function knows the order, so float the entry up with it
+    bool moved = false;
+    while (index > 0 && heap->heapify(heap, heap_parent(heap, index))) {
+        index = heap_parent(heap, index);
+        moved = true;
     }
 
-    return false;
+    if (!moved)
+        heap->heapify(heap, index);
+}
+
+bool max_heapify(heap_t *heap, int index)
+{
+    return sift_down(heap, index, 1);
 }
 
 bool min_heapify(heap_t *heap, int index)
 {
-    int smallest;
-    int left = heap_left(index);
-    int right = heap_right(index);
+    return sift_down(heap, index, -1);
+}
+
+static bool heap_reserve(heap_t *heap, int count)
+{
+    if (count <= heap->capacity)
+        return true;
+
+    int capacity = heap->capacity;
+    while (capacity < count)
+        capacity *= 2;
+
+    heap_entry_t *array = memory_realloc(MEMORY_HEAP, heap->array,
+                                         capacity * sizeof(heap_entry_t));
+    if (array == NULL)
+        return false;
+    heap->array = array;
+
+    int *positions = memory_realloc(MEMORY_HEAP, heap->positions, capacity * sizeof(int));
+    if (positions == NULL)
+        return false;
+    heap->positions = positions;
+
+    heap->capacity = capacity;
+
+    return true;
+}
+
+// Append a value without restoring the heap
+static heap_handle_t heap_append(heap_t *heap, void *value)
+{
+    heap_handle_t handle;
 
-    if (left < heap->size && heap->cmp(heap_get(heap, left), heap_get(heap, index)) < 0) {
-        smallest = left;
+    if (heap->free_handle >= 0) {
+        handle = heap->free_handle;
+        heap->free_handle = -2 - heap->positions[handle];
     } else {
-        smallest = index;
+        // live handles never outnumber the entries, so this fits in positions
+        handle = heap->handles++;
     }
 
-    if (right < heap->size && heap->cmp(heap_get(heap, right), heap_get(heap, smallest)) < 0) {
-        smallest = right;
-    }
+    heap_place(heap, heap->size++, (heap_entry_t) { value, handle });
 
-    if (smallest != index) {
-        void **temp = heap->array[index];
-        heap->array[index] = heap->array[smallest];
-        heap->array[smallest] = temp;
-        heap->heapify(heap, smallest);
-        return true;
-    }
+    return handle;
+}
 
-    return false;
+static void heap_release(heap_t *heap, heap_handle_t handle)
+{
+    heap->positions[handle] = -2 - heap->free_handle;
+    heap->free_handle = handle;
+}
+
+static bool heap_valid(heap_t *heap, heap_handle_t handle)
+{
+    return handle >= 0 && handle < heap->handles && heap->positions[handle] >= 0;
 }
 
 void **heap_get(heap_t *heap, int index)
 {
     if (index < 0 || index >= heap->size) return NULL;
 
-    void *value = heap->array[index];
+    void *value = heap->array[index].value;
 
     return value;
 }
 
+void *heap_value(heap_t *heap, heap_handle_t handle)
+{
+    if (!heap_valid(heap, handle)) return NULL;
+
+    return heap->array[heap->positions[handle]].value;
+}
+
+heap_handle_t heap_push(heap_t *heap, void *value)
+{
+    if (!heap_reserve(heap, heap->size + 1)) return HEAP_INVALID_HANDLE;
+
+    heap_handle_t handle = heap_append(heap, value);
+    heap_fix(heap, heap->size - 1);
+
+    return handle;
+}
+
 bool heap_insert(heap_t *heap, void *value)
 {
-    if (heap->size >= heap->capacity) return false;
+    return heap_push(heap, value) != HEAP_INVALID_HANDLE;
+}
 
-    int id = heap->size++;
-    int parentId = heap_parent(id);
-    heap->array[id] = value;
+bool heap_build(heap_t *heap, void **values, int count)
+{
+    if (count < 0 || !heap_reserve(heap, heap->size + count)) return false;
 
-    // float the value up
-    if (parentId != id) {
-        while (heap->heapify(heap, parentId)) {
-            parentId = heap_parent(parentId);
-        }
+    for (int i = 0; i < count; i++) {
+        heap_append(heap, values[i]);
+    }
+
+    // Floyd's method: heapify every parent bottom-up, which is linear time
+    for (int i = heap_parent(heap, heap->size - 1); heap->size > 1 && i >= 0; i--) {
+        heap->heapify(heap, i);
     }
 
     return true;
 }
 
-void **heap_extract(heap_t *heap)
+bool heap_update(heap_t *heap, heap_handle_t handle)
 {
-    if (heap->size < 1) return NULL;
+    if (!heap_valid(heap, handle)) return false;
+
+    heap_fix(heap, heap->positions[handle]);
+
+    return true;
+}
+
+void *heap_remove(heap_t *heap, heap_handle_t handle)
+{
+    if (!heap_valid(heap, handle)) return NULL;
 
-    void *value = heap_get(heap, 0);
+    int index = heap->positions[handle];
+    void *value = heap->array[index].value;
 
-    heap->array[0] = heap->array[--heap->size];
+    heap_release(heap, handle);
 
-    heap->heapify(heap, 0);
+    if (index != --heap->size) {
+        heap_place(heap, index, heap->array[heap->size]);
+        heap_fix(heap, index);
+    }
 
     return value;
 }
 
+void **heap_extract(heap_t *heap)
+{
+    if (heap->size < 1) return NULL;
+
+    return heap_remove(heap, heap->array[0].handle);
+}
+
 void heap_free(heap_t *heap)
 {
-    free(heap->array);
-    free(heap);
+    memory_free(MEMORY_HEAP, heap->positions);
+    memory_free(MEMORY_HEAP, heap->array);
+    memory_free(MEMORY_HEAP, heap);
 }
@@ -2,23 +2,196 @@
 #define __HEAP_H__
 
 #include <stdbool.h>
+#include "memory.h"
 
 typedef struct heap heap_t;
 
+/**
+ * Handle of a value in a heap. It stays the same while the value moves
+ * around the heap and may be reused once the value is removed.
+ */
+typedef int heap_handle_t;
+
+#define HEAP_INVALID_HANDLE -1
+
 typedef int(*heap_compare_func)(void *a, void *b);
 typedef bool(*heap_heapify_func)(heap_t *heap, int index);
 
+/*
+ * Heaps grow as values are inserted; the capacity passed when creating one
+ * is only the initial size of its storage.
+ */
 heap_t *heap_new(int capacity, heap_compare_func cmp, heap_heapify_func heapify);
 heap_t *heap_new_max(int capacity, heap_compare_func cmp);
 heap_t *heap_new_min(int capacity, heap_compare_func cmp);
 
+/**
+ * Create a heap where every node has arity children. Wider nodes make the
+ * heap shallower, so inserts compare less and a node's children share
+ * cache lines; 4 or 8 suit heaps with many more inserts than extracts.
+ * @param capacity initial capacity
+ * @param arity children per node, at least 2
+ * @param cmp function comparing two values
+ * @param heapify max_heapify, min_heapify or a custom function
+ * @return new heap, NULL on failure
+ */
+heap_t *heap_new_arity(int capacity, int arity, heap_compare_func cmp, heap_heapify_func heapify);
+
+bool max_heapify(heap_t *heap, int index);
+bool min_heapify(heap_t *heap, int index);
+
 int heap_size(heap_t *heap);
+int heap_arity(heap_t *heap);
 
 void **heap_get(heap_t *heap, int index);
 
 bool heap_insert(heap_t *heap, void *value);
+
+/**
+ * Insert a value and get a handle to it.
+ * @param heap heap to insert into
+ * @param value value to insert
+ * @return handle of the value, HEAP_INVALID_HANDLE if the heap could not grow
+ */
+heap_handle_t heap_push(heap_t *heap, void *value);
+
+/**
+ * Get the value of a handle.
+ * @param heap heap holding the value
+ * @param handle handle of the value
+ * @return the value, NULL if the handle is not in the heap
+ */
+void *heap_value(heap_t *heap, heap_handle_t handle);
+
+/**
+ * Move a value to its place after its priority changed, in O(log n).
+ * @param heap heap holding the value
+ * @param handle handle of the changed value
+ * @return false if the handle is not in the heap
+ */
+bool heap_update(heap_t *heap, heap_handle_t handle);
+
+/**
+ * Remove a value from anywhere in the heap in O(log n).
+ * @param heap heap holding the value
+ * @param handle handle of the value, invalid afterwards
+ * @return the removed value, NULL if the handle is not in the heap
+ */
+void *heap_remove(heap_t *heap, heap_handle_t handle);
+
+/**
+ * Add many values at once. They are appended and the heap is rebuilt bottom
+ * up, which takes linear time instead of the O(n log n) of n inserts.
+ * @param heap heap to add to
+ * @param values values to add
+ * @param count number of values
+ * @return false if the heap could not grow
+ */
+bool heap_build(heap_t *heap, void **values, int count);
+
 void **heap_extract(heap_t *heap);
 
 void heap_free(heap_t *heap);
 
+/**
+ * Define a binary heap that stores values of a type contiguously and
+ * compares them inline. It generates the type name_t and these functions:
+ *
+ *     void name_init(name_t *heap);
+ *     int name_size(name_t *heap);
+ *     type *name_top(name_t *heap);               NULL when empty
+ *     bool name_push(name_t *heap, type value);   false when out of memory
+ *     bool name_pop(name_t *heap, type *value);   false when empty
+ *     void name_destroy(name_t *heap);
+ *
+ * The storage grows as needed; name_init() allocates nothing.
+ * @param name prefix of the generated type and functions
+ * @param type element type
+ * @param less function or macro taking two values, true if the first
+ *             belongs closer to the top (a < b gives a min-heap)
+ */
+#define HEAP_DEFINE(name, type, less)                                           \
+    typedef struct name {                                                       \
+        type *array;                                                            \
+        int size;                                                               \
+        int capacity;                                                           \
+    } name##_t;                                                                 \
+                                                                                \
+    static inline void name##_init(name##_t *heap)                              \
+    {                                                                           \
+        heap->array = NULL;                                                     \
+        heap->size = 0;                                                         \
+        heap->capacity = 0;                                                     \
+    }                                                                           \
+                                                                                \
+    static inline int name##_size(name##_t *heap)                               \
+    {                                                                           \
+        return heap->size;                                                      \
+    }                                                                           \
+                                                                                \
+    static inline type *name##_top(name##_t *heap)                              \
+    {                                                                           \
+        return (heap->size > 0) ? &heap->array[0] : NULL;                       \
+    }                                                                           \
+                                                                                \
+    static inline bool name##_push(name##_t *heap, type value)                  \
+    {                                                                           \
+        if (heap->size == heap->capacity) {                                     \
+            int capacity = heap->capacity ? 2 * heap->capacity : 16;            \
+            type *array = memory_realloc(MEMORY_HEAP, heap->array,              \
+                                         capacity * sizeof(type));              \
+            if (array == NULL)                                                  \
+                return false;                                                   \
+            heap->array = array;                                                \
+            heap->capacity = capacity;                                          \
+        }                                                                       \
+                                                                                \
+        /* move parents down until the value's place is found */              \
+        int index = heap->size++;                                               \
+        while (index > 0) {                                                     \
+            int parent = (index - 1) / 2;                                       \
+            if (!(less(value, heap->array[parent])))                            \
+                break;                                                          \
+            heap->array[index] = heap->array[parent];                           \
+            index = parent;                                                     \
+        }                                                                       \
+        heap->array[index] = value;                                             \
+                                                                                \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    static inline bool name##_pop(name##_t *heap, type *value)                  \
+    {                                                                           \
+        if (heap->size < 1)                                                     \
+            return false;                                                       \
+                                                                                \
+        *value = heap->array[0];                                                \
+        type last = heap->array[--heap->size];                                  \
+                                                                                \
+        /* move children up until the last value's place is found */           \
+        int index = 0;                                                          \
+        for (;;) {                                                              \
+            int child = 2 * index + 1;                                          \
+            if (child >= heap->size)                                            \
+                break;                                                          \
+            if (child + 1 < heap->size &&                                       \
+                less(heap->array[child + 1], heap->array[child]))               \
+                child++;                                                        \
+            if (!(less(heap->array[child], last)))                              \
+                break;                                                          \
+            heap->array[index] = heap->array[child];                            \
+            index = child;                                                      \
+        }                                                                       \
+        if (heap->size > 0)                                                     \
+            heap->array[index] = last;                                          \
+                                                                                \
+        return true;                                                            \
+    }                                                                           \
+                                                                                \
+    static inline void name##_destroy(name##_t *heap)                           \
+    {                                                                           \
+        memory_free(MEMORY_HEAP, heap->array);                                  \
+        name##_init(heap);                                                      \
+    }
+
 #endif //__HEAP_H__
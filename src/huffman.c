@@ -1,4 +1,6 @@
 #include <assert.h>
+#include <endian.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,24 +8,45 @@
 #include "huffman.h"
 #include "heap.h"
 #include "list.h"
+#include "memory.h"
+#include "trace.h"
 
 struct huffman_node {
     char *str;
-    int freq;
+    uint64_t freq;
     huffman_node_t *parent;
     huffman_node_t *left;
     huffman_node_t *right;
 };
 
-int sort_letters(const char input[], huffman_node_t *nodes[]);
-int huffman_compare(void *a, void *b);
-huffman_node_t *build_huffman_tree(heap_t *heap, const char *input, huffman_node_t *nodes[], int *tree_size);
+/**
+ * Sync points into an encoded message.
+ * offsets[i] is the bit offset of symbol (i + 1) * interval.
+ */
+struct huffman_sync {
+    unsigned int interval;
+    uint64_t count;
+    uint64_t *offsets;
+};
+
+// serialized sync points start with the interval and the width of each delta
+#define SYNC_INTERVAL_BITS 32
+#define SYNC_WIDTH_BITS 6
+
+int sort_letters(uint64_t freq[], huffman_node_t *nodes[]);
+#define NODE_LESS(a, b) ((a)->freq < (b)->freq)
+HEAP_DEFINE(node_heap, huffman_node_t *, NODE_LESS)
+
+huffman_node_t *build_huffman_tree(huffman_node_t *nodes[], int *tree_size);
+bool decode_symbol(huffman_node_t *root, bit_array_t *bits, uint64_t bit_len,
+                   uint64_t *pos, char *symbol);
 void huffman_index_chars(huffman_node_t *node, char *index[], char *prefix);
+void huffman_node_free(huffman_node_t *node);
 
 huffman_node_t *huffman_build_tree(bit_array_t *bits)
 {
-    int i = 0;
-    int bit_length = bit_array_length(bits);
+    uint64_t i = 0;
+    uint64_t bit_length = bit_array_length(bits);
     huffman_node_t *root = NULL;
     huffman_node_t *node = NULL;
     while (i < bit_length) {
@@ -31,77 +54,140 @@ huffman_node_t *huffman_build_tree(bit_array_t *bits)
             node = node->parent;
         }
 
+        // the tree is complete but bits are left over
+        if (root != NULL && node == NULL)
+            goto invalid;
+
+        huffman_node_t *new_node = memory_calloc(MEMORY_HUFFMAN, 1, sizeof(huffman_node_t));
+        if (new_node == NULL)
+            goto invalid;
+
+        new_node->parent = node;
+        if (node == NULL) {
+            root = new_node;
+        } else if (node->left == NULL) {
+            node->left = new_node;
+        } else {
+            node->right = new_node;
+        }
+
         if (!bit_array_test(bits, i)) {
             i++;
-            huffman_node_t *new_node = calloc(1, sizeof(huffman_node_t));
-            new_node->parent = node;
-            if (node == NULL) {
-                root = new_node;
-                node = new_node;
-            } else {
-                if (node->left == NULL) {
-                    node->left = new_node;
-                    node = node->left;
-                } else if (node->right == NULL) {
-                    node->right = new_node;
-                    node = node->right;
-                } else {
-                    assert(node->left == NULL && node->right == NULL);
-                }
-            }
+            node = new_node;
         } else {
+            // a leaf marker is followed by its 8-bit letter
+            if (bit_length - i < 9)
+                goto invalid;
+
             char letter = 0;
             i++;
             for (int j = 7; j >= 0; j--) {
                 if (bit_array_test(bits, i++))
                     letter |= (1 << j);
             }
-            if (node->left == NULL) {
-                node->left = calloc(1, sizeof(huffman_node_t));
-                node->left->str = calloc(2, sizeof(char));
-                node->left->str[0] = letter;
-            } else if (node->right == NULL) {
-                node->right = calloc(1, sizeof(huffman_node_t));
-                node->right->str = calloc(2, sizeof(char));
-                node->right->str[0] = letter;
-            } else {
-                assert(node->left == NULL && node->right == NULL);
-            }
+
+            new_node->str = memory_calloc(MEMORY_HUFFMAN, 2, sizeof(char));
+            if (new_node->str == NULL)
+                goto invalid;
+            new_node->str[0] = letter;
         }
     }
 
-    return root;
+    // every internal node needs both children
+    while (node != NULL && node->left != NULL && node->right != NULL) {
+        node = node->parent;
+    }
+
+    if (node == NULL)
+        return root;
+
+invalid:
+    huffman_node_free(root);
+    return NULL;
 }
 
-huffman_node_t *huffman_new_tree(const char *input, int *tree_size, int *unique_letters)
+void huffman_count(const char *input, size_t length, uint64_t freq[256])
 {
-    huffman_node_t **nodes = calloc(256, sizeof(huffman_node_t*));
-    *unique_letters = sort_letters(input, nodes);
+    for (size_t i = 0; i < length; i++) {
+        freq[(uint8_t) input[i]]++;
+    }
+}
+
+huffman_node_t *huffman_new_tree_counts(uint64_t freq[256], int *tree_size, int *unique_letters)
+{
+    huffman_node_t **nodes = memory_calloc(MEMORY_HUFFMAN, 256, sizeof(huffman_node_t*));
+    *unique_letters = sort_letters(freq, nodes);
 
     // build priority queue and get root node
-    heap_t *heap = heap_new_min(strlen(input), huffman_compare);
+    return build_huffman_tree(nodes, tree_size);
+}
+
+huffman_node_t *huffman_new_tree(const char *input, int *tree_size, int *unique_letters)
+{
+    uint64_t freq[256] = { 0 };
+    huffman_count(input, strlen(input), freq);
 
-    return build_huffman_tree(heap, input, nodes, tree_size);
+    return huffman_new_tree_counts(freq, tree_size, unique_letters);
 }
 
 char **huffman_build_index(huffman_node_t *root)
 {
-    char **index = calloc(256, sizeof(char*));
+    char **index = memory_calloc(MEMORY_HUFFMAN, 256, sizeof(char*));
 
-    huffman_index_chars(root, index, "");
+    // a lone letter still needs one bit per occurrence
+    if (root != NULL && root->left == NULL && root->right == NULL)
+        huffman_index_chars(root, index, "0");
+    else
+        huffman_index_chars(root, index, "");
 
     return index;
 }
 
-void huffman_encode_bits(bit_array_t *array, char *index[], char *input)
+uint64_t huffman_encoded_length(char *index[], const char *message, size_t length)
 {
-    int pos = 0;
-    for (int i = 0; i < strlen(input); i++) {
-        char *bits = index[(int) input[i]];
-        for (int j = 0; j < strlen(bits); j++) {
-            if (bits[j] == '1')
-                bit_array_set(array, pos);
-            pos++;
+    size_t code_length[256];
+    for (int i = 0; i < 256; i++) {
+        code_length[i] = (index[i] != NULL) ? strlen(index[i]) : 0;
+    }
+
+    uint64_t compressed_bits = 0;
+    for (size_t i = 0; i < length; i++) {
+        compressed_bits += code_length[(uint8_t) message[i]];
+    }
+
+    return compressed_bits;
+}
+
+void huffman_encode_range(char *index[], const char *message, size_t start, size_t end,
+                          bit_array_t *bits, uint64_t *pos)
+{
+    uint64_t codes[256];
+    int lengths[256];
+
+    // pack codes into words so each symbol is a single append
+    for (int c = 0; c < 256; c++) {
+        codes[c] = 0;
+        lengths[c] = (index[c] != NULL) ? strlen(index[c]) : 0;
+
+        for (int j = 0; j < lengths[c] && j < 64; j++) {
+            if (index[c][j] == '1')
+                codes[c] |= (uint64_t) 1 << j;
+        }
+    }
+
+    for (size_t i = start; i < end; i++) {
+        uint8_t c = message[i];
+
+        if (lengths[c] <= 64) {
+            bit_array_append(bits, pos, codes[c], lengths[c]);
+            continue;
+        }
+
+        // codes this long need a degenerate tree over billions of symbols
+        for (char *code = index[c]; *code != '\0'; code++) {
+            if (*code == '1')
+                bit_array_set(bits, *pos);
+            (*pos)++;
         }
     }
 }
@@ -139,97 +225,436 @@ bit_array_t *huffman_encode_tree(huffman_node_t *root, int tree_size, int unique
 
 bit_array_t *huffman_encode(char *index[], char *message)
 {
-    // count compressed bit count
-    int compressed_bits = 0;
-    for (int i = 0; i < strlen(message); i++) {
-        compressed_bits += strlen(index[(int) message[i]]);
-    }
+    size_t length = strlen(message);
+    uint64_t pos = 0;
 
-    bit_array_t *bits = bit_array_new(compressed_bits);
+    bit_array_t *bits = bit_array_new(huffman_encoded_length(index, message, length));
 
-    huffman_encode_bits(bits, index, message);
+    huffman_encode_range(index, message, 0, length, bits, &pos);
 
     return bits;
 }
 
+/**
+ * Speculatively decoded chunk of a bitstream.
+ */
+typedef struct decode_chunk {
+    huffman_node_t *root;
+    bit_array_t *bits;
+    int number;             /**< position of the chunk in the stream */
+    uint64_t start;     /**< first bit of the chunk */
+    uint64_t end;       /**< first bit of the next chunk */
+    uint64_t next;      /**< start of the first symbol at or after end */
+    char *symbols;
+    size_t count;
+    size_t capacity;
+} decode_chunk_t;
+
+// Decode the symbol starting at bit *pos, false if the stream ends first
+bool decode_symbol(huffman_node_t *root, bit_array_t *bits, uint64_t bit_len,
+                   uint64_t *pos, char *symbol)
+{
+    huffman_node_t *node = root;
+    if (node->left == NULL && node->right == NULL) {
+        // single letter alphabets use one bit per letter
+        if (*pos >= bit_len)
+            return false;
+        (*pos)++;
+    }
+
+    while (node->left != NULL && node->right != NULL) {
+        if (*pos >= bit_len)
+            return false;
+        node = bit_array_test(bits, (*pos)++) ? node->right : node->left;
+    }
+
+    *symbol = node->str[0];
+    return true;
+}
+
 char *huffman_decode(huffman_node_t *root, bit_array_t *bits)
 {
-    int index = 0;
-    int i = 0;
-    int bit_len = bit_array_length(bits);
-    char decoded[bit_len];
+    uint64_t bit_len = bit_array_length(bits);
+    uint64_t pos = 0;
+    size_t length = 0;
+    char symbol;
+
+    // the letter count isn't stored, so guess four bits per letter and grow
+    size_t capacity = bit_len / 4 + 16;
+    char *decoded = memory_malloc(MEMORY_HUFFMAN, capacity);
+    if (decoded == NULL)
+        return NULL;
+
+    while (decode_symbol(root, bits, bit_len, &pos, &symbol)) {
+        if (length + 1 == capacity) {
+            char *grown = memory_realloc(MEMORY_HUFFMAN, decoded, 2 * capacity);
+            if (grown == NULL) {
+                memory_free(MEMORY_HUFFMAN, decoded);
+                return NULL;
+            }
+            decoded = grown;
+            capacity *= 2;
+        }
+        decoded[length++] = symbol;
+    }
+    decoded[length] = '\0';
 
-    huffman_node_t *node = root;
-    while (i <= bit_len) {
-        if (node->left == NULL && node->right == NULL) {
-            decoded[index++] = node->str[0];
-            node = root;
+    char *shrunk = memory_realloc(MEMORY_HUFFMAN, decoded, length + 1);
+    return (shrunk != NULL) ? shrunk : decoded;
+}
+
+bool decode_chunk_push(decode_chunk_t *chunk, char symbol)
+{
+    if (chunk->count == chunk->capacity) {
+        size_t capacity = 2 * chunk->capacity + 16;
+        char *symbols = memory_realloc(MEMORY_HUFFMAN, chunk->symbols, capacity);
+        if (symbols == NULL)
+            return false;
+        chunk->symbols = symbols;
+
+        chunk->capacity = capacity;
+    }
+
+    chunk->symbols[chunk->count++] = symbol;
+    return true;
+}
+
+// Decode a chunk assuming a symbol starts at its first bit
+void *decode_chunk(void *arg)
+{
+    decode_chunk_t *chunk = arg;
+    uint64_t bit_len = bit_array_length(chunk->bits);
+    uint64_t pos = chunk->start;
+    char symbol;
+
+    trace_begin("decode", chunk->number);
+
+    while (pos < chunk->end) {
+        if (!decode_symbol(chunk->root, chunk->bits, bit_len, &pos, &symbol))
+            break;
+        if (!decode_chunk_push(chunk, symbol)) {
+            trace_end("decode", chunk->number);
+            return chunk;
+        }
+    }
+
+    chunk->next = pos;
+    trace_end("decode", chunk->number);
+    return NULL;
+}
+
+char *huffman_decode_parallel(huffman_node_t *root, bit_array_t *bits, int threads)
+{
+    uint64_t bit_len = bit_array_length(bits);
+
+    if (threads < 2 || bit_len < (uint64_t) threads * 1024)
+        return huffman_decode(root, bits);
+
+    decode_chunk_t *chunks = memory_calloc(MEMORY_HUFFMAN, threads, sizeof(decode_chunk_t));
+    pthread_t *ids = memory_calloc(MEMORY_HUFFMAN, threads, sizeof(pthread_t));
+    bool failed = chunks == NULL || ids == NULL;
+
+    // decode every chunk from an arbitrary, possibly wrong, start position
+    for (int t = 0; !failed && t < threads; t++) {
+        chunks[t].root = root;
+        chunks[t].bits = bits;
+        chunks[t].number = t;
+        // split as bit_len * t / threads without overflowing the product
+        chunks[t].start = bit_len / threads * t + bit_len % threads * t / threads;
+        chunks[t].end = bit_len / threads * (t + 1) + bit_len % threads * (t + 1) / threads;
+        chunks[t].capacity = (chunks[t].end - chunks[t].start) / 4;
+        chunks[t].symbols = memory_malloc(MEMORY_HUFFMAN, chunks[t].capacity);
+        failed = chunks[t].symbols == NULL;
+    }
+
+    int started = 0;
+    for (; !failed && started < threads; started++) {
+        if (pthread_create(&ids[started], NULL, decode_chunk, &chunks[started]) != 0)
+            break;
+    }
+
+    for (int t = 0; t < started; t++) {
+        void *result;
+        pthread_join(ids[t], &result);
+        failed |= result != NULL;
+    }
+
+    failed |= started < threads;
+
+    // the first chunk started on a real symbol boundary; fix up the others in order
+    // by decoding from the true boundary until it meets a speculated symbol start,
+    // which is found by replaying the speculative decode alongside it
+    decode_chunk_t *fixups = memory_calloc(MEMORY_HUFFMAN, threads, sizeof(decode_chunk_t));
+    size_t *first = memory_calloc(MEMORY_HUFFMAN, threads, sizeof(size_t));
+    size_t total = 0;
+    failed |= fixups == NULL || first == NULL;
+
+    trace_begin("fixup", -1);
+    for (int t = 0; !failed && t < threads; t++) {
+        uint64_t pos = (t == 0) ? 0 : chunks[t - 1].next;
+        uint64_t speculated = chunks[t].start;
+        size_t found = 0;
+        char symbol;
+
+        while (pos < chunks[t].end && pos != speculated) {
+            if (speculated < pos) {
+                // below end, so this replays a symbol the chunk already decoded
+                decode_symbol(root, bits, bit_len, &speculated, &symbol);
+                found++;
+                continue;
+            }
+            if (!decode_symbol(root, bits, bit_len, &pos, &symbol))
+                break;
+            if (!decode_chunk_push(&fixups[t], symbol)) {
+                failed = true;
+                break;
+            }
+        }
+
+        if (pos == speculated) {
+            first[t] = found;
         } else {
-            bool left = (bit_array_test(bits, i)) ? false : true;
-            if (left)
-                node = node->left;
-            else
-                node = node->right;
-            i++;
+            // never synchronized, everything speculated in this chunk is wrong
+            first[t] = chunks[t].count;
+            chunks[t].next = pos;
         }
+
+        total += fixups[t].count + chunks[t].count - first[t];
+    }
+    trace_end("fixup", -1);
+
+    char *decoded = failed ? NULL : memory_malloc(MEMORY_HUFFMAN, total + 1);
+
+    if (decoded != NULL) {
+        size_t index = 0;
+        for (int t = 0; t < threads; t++) {
+            // chunks that started on a boundary have no fixup buffer
+            if (fixups[t].count > 0)
+                memcpy(decoded + index, fixups[t].symbols, fixups[t].count);
+            index += fixups[t].count;
+            memcpy(decoded + index, chunks[t].symbols + first[t], chunks[t].count - first[t]);
+            index += chunks[t].count - first[t];
+        }
+        decoded[index] = '\0';
     }
 
-    decoded[index] = '\0';
+    for (int t = 0; t < threads; t++) {
+        if (chunks != NULL)
+            memory_free(MEMORY_HUFFMAN, chunks[t].symbols);
+        if (fixups != NULL)
+            memory_free(MEMORY_HUFFMAN, fixups[t].symbols);
+    }
 
-    return strdup(decoded);
+    memory_free(MEMORY_HUFFMAN, chunks);
+    memory_free(MEMORY_HUFFMAN, fixups);
+    memory_free(MEMORY_HUFFMAN, first);
+    memory_free(MEMORY_HUFFMAN, ids);
+
+    // the speculative buffers are gone, so there may be room to decode in one go
+    if (decoded == NULL)
+        return huffman_decode(root, bits);
+
+    return decoded;
 }
 
-int sort_letters(const char input[], huffman_node_t *nodes[])
+size_t huffman_decode_range(huffman_node_t *root, bit_array_t *bits, huffman_sync_t *sync,
+                            size_t offset, size_t length, char *output)
 {
-    int unique = 0;
+    uint64_t i = 0;
+    uint64_t bit_len = bit_array_length(bits);
+    size_t symbol = 0;
+    size_t n = 0;
+
+    // jump to the closest sync point before the range
+    if (sync != NULL && sync->count > 0 && offset >= sync->interval) {
+        size_t point = offset / sync->interval;
+        if (point > sync->count)
+            point = sync->count;
+        i = sync->offsets[point - 1];
+        symbol = point * sync->interval;
+    }
 
-    // Reset letter nodes
+    // decode from there, keeping only symbols inside the range
+    char letter;
+    while (n < length && decode_symbol(root, bits, bit_len, &i, &letter)) {
+        if (symbol++ >= offset)
+            output[n++] = letter;
+    }
+
+    return n;
+}
+
+void huffman_header_encode(uint8_t header[HUFFMAN_HEADER_SIZE])
+{
+    uint32_t version = htole32(HUFFMAN_VERSION);
+
+    memcpy(header, HUFFMAN_MAGIC, HUFFMAN_MAGIC_SIZE);
+    memcpy(header + HUFFMAN_MAGIC_SIZE, &version, sizeof(version));
+}
+
+uint32_t huffman_header_version(const uint8_t *data, size_t size)
+{
+    uint32_t version;
+
+    // a legacy file starts with the tree length, which never reaches the magic number
+    if (size < HUFFMAN_HEADER_SIZE || memcmp(data, HUFFMAN_MAGIC, HUFFMAN_MAGIC_SIZE) != 0)
+        return HUFFMAN_VERSION_LEGACY;
+
+    memcpy(&version, data + HUFFMAN_MAGIC_SIZE, sizeof(version));
+    return le32toh(version);
+}
+
+huffman_sync_t *huffman_sync_new(char *index[], const char *message, size_t length,
+                                 unsigned int interval)
+{
+    huffman_sync_t *sync = memory_calloc(MEMORY_HUFFMAN, 1, sizeof(huffman_sync_t));
+    if (sync == NULL)
+        return NULL;
+
+    sync->interval = interval;
+    sync->count = (interval > 0 && length > 0) ? (length - 1) / interval : 0;
+    sync->offsets = memory_calloc(MEMORY_HUFFMAN, sync->count + 1, sizeof(uint64_t));
+
+    size_t code_length[256];
     for (int i = 0; i < 256; i++) {
-        char str[] = { i, '\0' };
+        code_length[i] = (index[i] != NULL) ? strlen(index[i]) : 0;
+    }
 
-        nodes[i] = calloc(1, sizeof(huffman_node_t));
-        nodes[i]->str = strdup(str);
-        nodes[i]->freq = 0;
+    uint64_t pos = 0;
+    for (size_t i = 0, point = 0; point < sync->count; i++) {
+        if (i > 0 && i % interval == 0)
+            sync->offsets[point++] = pos;
+        pos += code_length[(uint8_t) message[i]];
     }
 
-    size_t len = strlen(input);
-    for (int i = 0; i < len; i++) {
-        if (nodes[(int) input[i]]->freq == 0)
-            unique++;
+    return sync;
+}
 
-        nodes[(int) input[i]]->freq++;
+void sync_write_field(bit_array_t *bits, uint64_t *pos, uint64_t value, int width)
+{
+    for (int j = width - 1; j >= 0; j--) {
+        if ((value & ((uint64_t) 1 << j)) != 0)
+            bit_array_set(bits, *pos);
+        (*pos)++;
     }
+}
 
-    return unique;
+uint64_t sync_read_field(bit_array_t *bits, uint64_t *pos, int width)
+{
+    uint64_t value = 0;
+    for (int j = width - 1; j >= 0; j--) {
+        if (bit_array_test(bits, (*pos)++))
+            value |= ((uint64_t) 1 << j);
+    }
+    return value;
+}
+
+bit_array_t *huffman_sync_encode(huffman_sync_t *sync)
+{
+    // sync points are stored as deltas of the smallest width that fits them all
+    uint64_t max_delta = 0;
+    for (uint64_t i = 0, prev = 0; i < sync->count; prev = sync->offsets[i++]) {
+        if (sync->offsets[i] - prev > max_delta)
+            max_delta = sync->offsets[i] - prev;
+    }
+
+    int width = 1;
+    while (width < 63 && (max_delta >> width) != 0)
+        width++;
+
+    uint64_t pos = 0;
+    bit_array_t *bits = bit_array_new(SYNC_INTERVAL_BITS + SYNC_WIDTH_BITS + sync->count * width);
+
+    sync_write_field(bits, &pos, sync->interval, SYNC_INTERVAL_BITS);
+    sync_write_field(bits, &pos, width, SYNC_WIDTH_BITS);
+    for (uint64_t i = 0, prev = 0; i < sync->count; prev = sync->offsets[i++]) {
+        sync_write_field(bits, &pos, sync->offsets[i] - prev, width);
+    }
+
+    return bits;
+}
+
+huffman_sync_t *huffman_sync_decode(bit_array_t *bits)
+{
+    uint64_t pos = 0;
+    uint64_t bit_len = bit_array_length(bits);
+
+    if (bit_len < SYNC_INTERVAL_BITS + SYNC_WIDTH_BITS)
+        return NULL;
+
+    unsigned int interval = sync_read_field(bits, &pos, SYNC_INTERVAL_BITS);
+    int width = sync_read_field(bits, &pos, SYNC_WIDTH_BITS);
+
+    if (interval == 0 || width == 0 || width > 63)
+        return NULL;
+
+    huffman_sync_t *sync = memory_calloc(MEMORY_HUFFMAN, 1, sizeof(huffman_sync_t));
+    if (sync == NULL)
+        return NULL;
+
+    sync->interval = interval;
+    sync->count = (bit_len - pos) / width;
+    sync->offsets = memory_calloc(MEMORY_HUFFMAN, sync->count + 1, sizeof(uint64_t));
+
+    for (uint64_t i = 0, offset = 0; i < sync->count; i++) {
+        offset += sync_read_field(bits, &pos, width);
+        sync->offsets[i] = offset;
+    }
+
+    return sync;
 }
 
-int huffman_compare(void *a, void *b)
+void huffman_sync_free(huffman_sync_t *sync)
 {
-    huffman_node_t *l1 = a;
-    huffman_node_t *l2 = b;
+    if (sync == NULL) return;
 
-    return l1->freq - l2->freq;
+    memory_free(MEMORY_HUFFMAN, sync->offsets);
+    memory_free(MEMORY_HUFFMAN, sync);
 }
 
-huffman_node_t *build_huffman_tree(heap_t *heap, const char *input, huffman_node_t *nodes[], int *tree_size)
+int sort_letters(uint64_t freq[], huffman_node_t *nodes[])
 {
+    int unique = 0;
+
+    // Reset letter nodes
+    for (int i = 0; i < 256; i++) {
+        char str[] = { i, '\0' };
+
+        nodes[i] = memory_calloc(MEMORY_HUFFMAN, 1, sizeof(huffman_node_t));
+        nodes[i]->str = memory_strdup(MEMORY_HUFFMAN, str);
+        nodes[i]->freq = freq[i];
+
+        if (freq[i] > 0)
+            unique++;
+    }
+
+    return unique;
+}
+
+huffman_node_t *build_huffman_tree(huffman_node_t *nodes[], int *tree_size)
+{
+    node_heap_t heap;
+    node_heap_init(&heap);
+
     // insert letters
     for (int i = 0; i < 256; i++) {
         if (nodes[i]->freq > 0) {
-            heap_insert(heap, nodes[i]);
+            node_heap_push(&heap, nodes[i]);
             (*tree_size)++;
         } else {
-            free(nodes[i]->str);
-            free(nodes[i]);
+            memory_free(MEMORY_HUFFMAN, nodes[i]->str);
+            memory_free(MEMORY_HUFFMAN, nodes[i]);
         }
     }
 
     // build tree
-    while (heap_size(heap) > 1) {
-        huffman_node_t *left = (huffman_node_t *) heap_extract(heap);
-        huffman_node_t *right = (huffman_node_t *) heap_extract(heap);
+    while (node_heap_size(&heap) > 1) {
+        huffman_node_t *left;
+        huffman_node_t *right;
+        node_heap_pop(&heap, &left);
+        node_heap_pop(&heap, &right);
 
-        huffman_node_t *node = calloc(1, sizeof(huffman_node_t));
+        huffman_node_t *node = memory_calloc(MEMORY_HUFFMAN, 1, sizeof(huffman_node_t));
         node->left = left;
         node->right = right;
         node->freq = 0;
@@ -246,17 +671,19 @@ huffman_node_t *build_huffman_tree(heap_t *heap, const char *input, huffman_node
             node->freq += right->freq;
         }
 
-        node->str = calloc(strlen(node->left->str) + strlen(node->right->str) + 1, sizeof(char));
+        node->str = memory_calloc(MEMORY_HUFFMAN,
+                                  strlen(node->left->str) + strlen(node->right->str) + 1,
+                                  sizeof(char));
         sprintf(node->str, "%s%s", node->left->str, node->right->str);
 
-        heap_insert(heap, node);
+        node_heap_push(&heap, node);
         (*tree_size)++;
     }
 
-    huffman_node_t *root = (huffman_node_t *) heap_get(heap, 0);
+    huffman_node_t *root = (node_heap_size(&heap) > 0) ? *node_heap_top(&heap) : NULL;
 
-    heap_free(heap);
-    free(nodes);
+    node_heap_destroy(&heap);
+    memory_free(MEMORY_HUFFMAN, nodes);
 
     return root;
 }
@@ -266,7 +693,7 @@ void huffman_index_chars(huffman_node_t *node, char *index[], char *prefix)
     if (node == NULL) return;
 
     if (node->left == NULL && node->right == NULL) {
-        index[(int) node->str[0]] = strdup(prefix);
+        index[(uint8_t) node->str[0]] = memory_strdup(MEMORY_HUFFMAN, prefix);
     } else {
         char prefixLeft[strlen(prefix) + 1];
         char prefixRight[strlen(prefix) + 1];
@@ -286,16 +713,16 @@ void huffman_node_free(huffman_node_t *node)
     huffman_node_free(node->left);
     huffman_node_free(node->right);
 
-    free(node->str);
-    free(node);
+    memory_free(MEMORY_HUFFMAN, node->str);
+    memory_free(MEMORY_HUFFMAN, node);
 }
 
 void huffman_free(huffman_node_t *root, char *index[])
 {
     if (index != NULL) {
         for (int i = 0; i < 256; i++)
-            free(index[i]);
-        free(index);
+            memory_free(MEMORY_HUFFMAN, index[i]);
+        memory_free(MEMORY_HUFFMAN, index);
     }
 
     huffman_node_free(root);
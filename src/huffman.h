@@ -1,20 +1,66 @@
 #ifndef __HUFFMAN_H__
 #define __HUFFMAN_H__
 
+#include <stddef.h>
+#include <stdint.h>
 #include "bit_array.h"
 
 typedef struct huffman_node huffman_node_t;
+typedef struct huffman_sync huffman_sync_t;
 
+// compressed files start with a magic number and the format version; legacy files
+// written before the header existed have none and store 32-bit array lengths
+#define HUFFMAN_MAGIC "\x89HUF"
+#define HUFFMAN_MAGIC_SIZE 4
+#define HUFFMAN_HEADER_SIZE 8
+#define HUFFMAN_VERSION_LEGACY 1
+#define HUFFMAN_VERSION 2
+
+/**
+ * Fill in the header written at the start of compressed files.
+ * @param header stores the magic number and the current version
+ */
+void huffman_header_encode(uint8_t header[HUFFMAN_HEADER_SIZE]);
+
+/**
+ * Get the format version of a compressed file from its first bytes.
+ * @param data start of the file
+ * @param size bytes available at data
+ * @return the version, HUFFMAN_VERSION_LEGACY if there is no header
+ */
+uint32_t huffman_header_version(const uint8_t *data, size_t size);
+
+void huffman_count(const char *input, size_t length, uint64_t freq[256]);
+huffman_node_t *huffman_new_tree_counts(uint64_t freq[256], int *tree_size, int *unique_letters);
 huffman_node_t *huffman_new_tree(const char *input, int *tree_size, int *unique_letters);
+/**
+ * Rebuild a tree from its serialized bits.
+ * @param bits serialized tree
+ * @return the root, NULL if the bits do not describe exactly one full tree
+ */
 huffman_node_t *huffman_build_tree(bit_array_t *bits);
 
 char **huffman_build_index(huffman_node_t *root);
 
 bit_array_t *huffman_encode_tree(huffman_node_t *root, int tree_size, int unique_letters);
 
+uint64_t huffman_encoded_length(char *index[], const char *message, size_t length);
+void huffman_encode_range(char *index[], const char *message, size_t start, size_t end,
+                          bit_array_t *bits, uint64_t *pos);
 bit_array_t *huffman_encode(char *index[], char *message);
 
+// decoded strings are freed with memory_free(MEMORY_HUFFMAN, ...); a parallel decode
+// that fails falls back to decoding on the calling thread
 char *huffman_decode(huffman_node_t *root, bit_array_t *bits);
+char *huffman_decode_parallel(huffman_node_t *root, bit_array_t *bits, int threads);
+size_t huffman_decode_range(huffman_node_t *root, bit_array_t *bits, huffman_sync_t *sync,
+                            size_t offset, size_t length, char *output);
+
+huffman_sync_t *huffman_sync_new(char *index[], const char *message, size_t length,
+                                 unsigned int interval);
+bit_array_t *huffman_sync_encode(huffman_sync_t *sync);
+huffman_sync_t *huffman_sync_decode(bit_array_t *bits);
+void huffman_sync_free(huffman_sync_t *sync);
 
 void huffman_free(huffman_node_t *root, char *index[]);
 
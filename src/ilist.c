@@ -0,0 +1,128 @@
+#include "ilist.h"
+
+void ilist_init(ilist_t *list)
+{
+    list->first = NULL;
+    list->last = NULL;
+    list->length = 0;
+}
+
+void ilist_append(ilist_t *list, ilist_link_t *link)
+{
+    ilist_insert_before(list, link, NULL);
+}
+
+void ilist_prepend(ilist_t *list, ilist_link_t *link)
+{
+    ilist_insert_before(list, link, list->first);
+}
+
+void ilist_insert_before(ilist_t *list, ilist_link_t *link, ilist_link_t *before)
+{
+    link->next = before;
+    link->prev = (before != NULL) ? before->prev : list->last;
+
+    if (link->prev != NULL) {
+        link->prev->next = link;
+    } else {
+        list->first = link;
+    }
+
+    if (before != NULL) {
+        before->prev = link;
+    } else {
+        list->last = link;
+    }
+
+    list->length++;
+}
+
+void ilist_remove(ilist_t *list, ilist_link_t *link)
+{
+    if (link->prev != NULL) {
+        link->prev->next = link->next;
+    } else {
+        list->first = link->next;
+    }
+
+    if (link->next != NULL) {
+        link->next->prev = link->prev;
+    } else {
+        list->last = link->prev;
+    }
+
+    link->prev = NULL;
+    link->next = NULL;
+    list->length--;
+}
+
+ilist_link_t *ilist_pop_first(ilist_t *list)
+{
+    ilist_link_t *link = list->first;
+
+    if (link != NULL) {
+        ilist_remove(list, link);
+    }
+
+    return link;
+}
+
+ilist_link_t *ilist_first(ilist_t *list)
+{
+    return list->first;
+}
+
+ilist_link_t *ilist_last(ilist_t *list)
+{
+    return list->last;
+}
+
+int ilist_length(ilist_t *list)
+{
+    return list->length;
+}
+
+/**
+ * The link is its own value.
+ * @see iter_value_fun
+ */
+void *ilist_value(void *link)
+{
+    return link;
+}
+
+/**
+ * Get the next link.
+ * @see iter_next_fun
+ */
+void *ilist_next(void *link)
+{
+    return (link == NULL) ? NULL : ((ilist_link_t *) link)->next;
+}
+
+/**
+ * Get the previous link.
+ * @see iter_next_fun
+ */
+void *ilist_prev(void *link)
+{
+    return (link == NULL) ? NULL : ((ilist_link_t *) link)->prev;
+}
+
+iter_t *iter_ilist(ilist_t *list)
+{
+    if (list == NULL) {
+        return NULL;
+    }
+
+    return iter_new(list->first, ilist_value, ilist_next);
+}
+
+iter_t *iter_ilist_reverse(ilist_t *list)
+{
+    if (list == NULL) {
+        return NULL;
+    }
+
+    return iter_new(list->last, ilist_value, ilist_prev);
+}
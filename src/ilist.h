@@ -0,0 +1,123 @@
+/**
+ * Intrusive doubly linked list.
+ *
+ * Instead of the list allocating an element for every value, the values
+ * embed an ilist_link_t and are linked through it, so adding and removing
+ * never allocates. A value can be in as many lists as it has links, and
+ * must stay alive while linked. ilist_entry() gets a value from its link.
+ * @file
+ */
+#ifndef __ILIST_H__
+#define __ILIST_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "iter.h"
+
+/**
+ * Link embedded in values stored in an intrusive list.
+ */
+typedef struct ilist_link {
+    struct ilist_link *prev;
+    struct ilist_link *next;
+} ilist_link_t;
+
+/**
+ * Intrusive list type. Zero-initialize or call ilist_init() before use.
+ */
+typedef struct ilist {
+    ilist_link_t *first;
+    ilist_link_t *last;
+    int length;
+} ilist_t;
+
+/**
+ * Get the value containing a link.
+ * @param link link inside the value
+ * @param type type of the value
+ * @param member name of the link inside type
+ */
+#define ilist_entry(link, type, member) \
+    ((type *) ((char *) (link) - offsetof(type, member)))
+
+/**
+ * Initialize an empty list.
+ * @param list list to initialize
+ */
+void ilist_init(ilist_t *list);
+
+/**
+ * Add a link to the end of the list.
+ * @param list list to append to
+ * @param link link that is not in any list
+ */
+void ilist_append(ilist_t *list, ilist_link_t *link);
+
+/**
+ * Add a link to the beginning of the list.
+ * @param list list to prepend to
+ * @param link link that is not in any list
+ */
+void ilist_prepend(ilist_t *list, ilist_link_t *link);
+
+/**
+ * Insert a link in front of another one.
+ * @param list list to insert into
+ * @param link link that is not in any list
+ * @param before link in the list, NULL to append
+ */
+void ilist_insert_before(ilist_t *list, ilist_link_t *link, ilist_link_t *before);
+
+/**
+ * Unlink a link from the list.
+ * @param list list holding the link
+ * @param link link to remove
+ */
+void ilist_remove(ilist_t *list, ilist_link_t *link);
+
+/**
+ * Unlink the first link of the list.
+ * @param list list to remove from
+ * @return the removed link, NULL if the list is empty
+ */
+ilist_link_t *ilist_pop_first(ilist_t *list);
+
+/**
+ * Get the first link of the list.
+ * @param list list to check
+ * @return the first link, NULL if the list is empty
+ */
+ilist_link_t *ilist_first(ilist_t *list);
+
+/**
+ * Get the last link of the list.
+ * @param list list to check
+ * @return the last link, NULL if the list is empty
+ */
+ilist_link_t *ilist_last(ilist_t *list);
+
+/**
+ * Get the number of links in the list.
+ * @param list list to check
+ * @return number of links
+ */
+int ilist_length(ilist_t *list);
+
+/**
+ * Helper function to create an iterator over the links of the list.
+ * The values are ilist_link_t pointers.
+ * @param list list to iterate over
+ * @see iter_new()
+ * @return Iterator
+ */
+iter_t *iter_ilist(ilist_t *list);
+
+/**
+ * Helper function to create a reverse iterator over the links of the list.
+ * @param list list to iterate over
+ * @see iter_new()
+ * @return Iterator
+ */
+iter_t *iter_ilist_reverse(ilist_t *list);
+
+#endif //__ILIST_H__
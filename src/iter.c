@@ -3,17 +3,21 @@
  */
 #include <stdlib.h>
 #include "iter.h"
+#include "memory.h"
 
 struct iter {
     iter_value_func value;
     iter_next_func next;
+    iter_cursor_func restart;
+    iter_cursor_func free_cursor;
     void *start;
     void *current;
+    int steps;      /**< elements passed since the start */
 };
 
 iter_t *iter_new(void *start, iter_value_func value, iter_next_func next)
 {
-    iter_t *it = calloc(1, sizeof(iter_t));
+    iter_t *it = memory_calloc(MEMORY_ITER, 1, sizeof(iter_t));
 
     if (it != NULL) {
         it->value = value;
@@ -25,6 +29,21 @@ iter_t *iter_new(void *start, iter_value_func value, iter_next_func next)
     return it;
 }
 
+iter_t *iter_new_cursor(void *cursor, iter_value_func value, iter_next_func next,
+                        iter_cursor_func restart, iter_cursor_func free_cursor)
+{
+    iter_t *it = iter_new(cursor, value, next);
+
+    if (it != NULL) {
+        it->restart = restart;
+        it->free_cursor = free_cursor;
+    } else if (free_cursor != NULL) {
+        free_cursor(cursor);
+    }
+
+    return it;
+}
+
 bool iter_has_next(iter_t *it)
 {
     return it->current != NULL && it->value(it->current) != NULL;
@@ -34,12 +53,18 @@ void *iter_next(iter_t *it)
 {
     void *data = it->value(it->current);
     it->current = it->next(it->current);
+    it->steps++;
     return data;
 }
 
 void iter_restart(iter_t *it)
 {
     it->current = it->start;
+    it->steps = 0;
+
+    if (it->restart != NULL) {
+        it->restart(it->start);
+    }
 }
 
 void *iter_get(iter_t *it, int index)
@@ -62,6 +87,7 @@ void *iter_get(iter_t *it, int index)
 int iter_length(iter_t *it)
 {
     int count = 0;
+    int steps = it->steps;
     void *start = it->current;
 
     while (iter_has_next(it)) {
@@ -69,12 +95,26 @@ int iter_length(iter_t *it)
         count++;
     }
 
-    it->current = start;
+    if (it->restart != NULL) {
+        // a cursor can't be put back, so rewind it and step forward again
+        iter_restart(it);
+        while (it->steps < steps) {
+            iter_next(it);
+        }
+    } else {
+        it->current = start;
+        it->steps = steps;
+    }
+
     return count;
 }
 
 void iter_free(iter_t *it)
 {
-    free(it);
+    if (it != NULL && it->free_cursor != NULL) {
+        it->free_cursor(it->start);
+    }
+
+    memory_free(MEMORY_ITER, it);
 }
 
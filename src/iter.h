@@ -23,6 +23,11 @@ typedef void *(* iter_value_func)(void *);
  */
 typedef void *(* iter_next_func)(void *);
 
+/**
+ * Function pointer to rewind or free a cursor.
+ */
+typedef void (* iter_cursor_func)(void *);
+
 /**
  * Create a new iterator.
  * @param start starting point of iterator
@@ -32,6 +37,20 @@ typedef void *(* iter_next_func)(void *);
  */
 iter_t *iter_new(void *start, iter_value_func value, iter_next_func next);
 
+/**
+ * Create a new iterator over a cursor that keeps its own position, for
+ * structures whose elements can't be addressed by a pointer each. The
+ * cursor is the iterator's only element: next moves it and returns it.
+ * @param cursor cursor at the first element, owned by the iterator
+ * @param value fpointer to get the value at the cursor
+ * @param next fpointer to move the cursor to the next element
+ * @param restart fpointer to move the cursor back to the first element
+ * @param free_cursor fpointer to free the cursor with the iterator
+ * @return An iterator that points at the first element
+ */
+iter_t *iter_new_cursor(void *cursor, iter_value_func value, iter_next_func next,
+                        iter_cursor_func restart, iter_cursor_func free_cursor);
+
 /**
  * Check if the iterator has another element.
  * @param it iterator
@@ -0,0 +1,93 @@
+#include "lfstack.h"
+
+// cmpxchg16b is not part of the baseline x86-64 instruction set
+#if defined(__x86_64__)
+#define LFSTACK_TARGET __attribute__((target("cx16")))
+#else
+#define LFSTACK_TARGET
+#endif
+
+typedef unsigned __int128 pair_t;
+
+static inline pair_t make_pair(lfstack_node_t *node, uintptr_t tag)
+{
+    lfstack_t head = { .head = { { .node = node, .tag = tag } } };
+    return head.head.pair;
+}
+
+// Read both halves of the head; a torn read only makes the next swap fail
+static inline void load_head(lfstack_t *stack, lfstack_node_t **node, uintptr_t *tag)
+{
+    *tag = __atomic_load_n(&stack->head.tag, __ATOMIC_ACQUIRE);
+    *node = __atomic_load_n(&stack->head.node, __ATOMIC_ACQUIRE);
+}
+
+LFSTACK_TARGET
+static inline bool swap_head(lfstack_t *stack, lfstack_node_t *node, uintptr_t tag,
+                             lfstack_node_t *new_node, uintptr_t new_tag)
+{
+    return __sync_bool_compare_and_swap(&stack->head.pair, make_pair(node, tag),
+                                        make_pair(new_node, new_tag));
+}
+
+void lfstack_init(lfstack_t *stack)
+{
+    stack->head.node = NULL;
+    stack->head.tag = 0;
+}
+
+void lfstack_push(lfstack_t *stack, lfstack_node_t *node)
+{
+    lfstack_push_batch(stack, node, node);
+}
+
+LFSTACK_TARGET
+void lfstack_push_batch(lfstack_t *stack, lfstack_node_t *first, lfstack_node_t *last)
+{
+    lfstack_node_t *top;
+    uintptr_t tag;
+
+    do {
+        load_head(stack, &top, &tag);
+        __atomic_store_n(&last->next, top, __ATOMIC_RELAXED);
+    } while (!swap_head(stack, top, tag, first, tag));
+}
+
+LFSTACK_TARGET
+lfstack_node_t *lfstack_pop(lfstack_t *stack)
+{
+    lfstack_node_t *top;
+    lfstack_node_t *next;
+    uintptr_t tag;
+
+    do {
+        load_head(stack, &top, &tag);
+        if (top == NULL)
+            return NULL;
+
+        // top may be popped meanwhile, in which case the swap fails
+        next = __atomic_load_n(&top->next, __ATOMIC_RELAXED);
+    } while (!swap_head(stack, top, tag, next, tag + 1));
+
+    return top;
+}
+
+LFSTACK_TARGET
+lfstack_node_t *lfstack_pop_all(lfstack_t *stack)
+{
+    lfstack_node_t *top;
+    uintptr_t tag;
+
+    do {
+        load_head(stack, &top, &tag);
+        if (top == NULL)
+            return NULL;
+    } while (!swap_head(stack, top, tag, NULL, tag + 1));
+
+    return top;
+}
+
+bool lfstack_empty(lfstack_t *stack)
+{
+    return __atomic_load_n(&stack->head.node, __ATOMIC_ACQUIRE) == NULL;
+}
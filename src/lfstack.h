@@ -0,0 +1,95 @@
+/**
+ * Lock-free intrusive stack.
+ *
+ * A Treiber stack whose head is a pointer paired with a counter that every
+ * pop increments, both swapped with one double-width compare-and-swap. If
+ * a node is popped and pushed again between another thread reading the
+ * head and swapping it, the counter no longer matches and that thread
+ * retries, which rules out the ABA problem.
+ *
+ * Values embed an lfstack_node_t, so pushing and popping never allocate.
+ * A thread that loses a race may still read the next pointer of a node
+ * another thread just popped, so nodes must stay allocated (for example
+ * in a pool) while the stack is in use. This makes the stack a good free
+ * list for nodes shared between threads.
+ * @file
+ */
+#ifndef __LFSTACK_H__
+#define __LFSTACK_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Node embedded in values stored in a stack.
+ */
+typedef struct lfstack_node {
+    struct lfstack_node *next;
+} lfstack_node_t;
+
+/**
+ * Lock-free stack type. Zero-initialize or call lfstack_init() before use.
+ */
+typedef struct lfstack {
+    union {
+        struct {
+            lfstack_node_t *node;
+            uintptr_t tag;
+        };
+        unsigned __int128 pair;
+    } head __attribute__((aligned(16)));
+} lfstack_t;
+
+/**
+ * Get the value containing a node.
+ * @param node node inside the value
+ * @param type type of the value
+ * @param member name of the node inside type
+ */
+#define lfstack_entry(node, type, member) \
+    ((type *) ((char *) (node) - offsetof(type, member)))
+
+/**
+ * Initialize an empty stack.
+ * @param stack stack to initialize
+ */
+void lfstack_init(lfstack_t *stack);
+
+/**
+ * Push a node. Safe to call from several threads.
+ * @param stack stack to push to
+ * @param node node that is not in any stack
+ */
+void lfstack_push(lfstack_t *stack, lfstack_node_t *node);
+
+/**
+ * Push a chain of nodes linked through their next pointers at once.
+ * @param stack stack to push to
+ * @param first node that ends up on top
+ * @param last last node of the chain
+ */
+void lfstack_push_batch(lfstack_t *stack, lfstack_node_t *first, lfstack_node_t *last);
+
+/**
+ * Pop the top node. Safe to call from several threads.
+ * @param stack stack to pop from
+ * @return the node, NULL if the stack is empty
+ */
+lfstack_node_t *lfstack_pop(lfstack_t *stack);
+
+/**
+ * Pop every node at once.
+ * @param stack stack to empty
+ * @return the former top node, the rest linked through next pointers
+ */
+lfstack_node_t *lfstack_pop_all(lfstack_t *stack);
+
+/**
+ * Check if the stack is empty. Other threads may change it right away.
+ * @param stack stack to check
+ * @return true if there were no nodes
+ */
+bool lfstack_empty(lfstack_t *stack);
+
+#endif //__LFSTACK_H__
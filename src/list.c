@@ -3,15 +3,29 @@
  */
 #include <stdlib.h>
 #include "list.h"
+#include "memory.h"
+
+#define LIST_SLAB_MIN 64
+#define LIST_SLAB_MAX 4096
 
 typedef struct elem elem_t;
+typedef struct list_slab list_slab_t;
 
+/*
+ * Pooled lists carve their elements out of slabs that grow from
+ * LIST_SLAB_MIN to LIST_SLAB_MAX elements. Removed elements are kept on a
+ * free chain for reuse and the slabs are only freed with the list.
+ */
 struct list {
     list_compare_func cmp;
     list_free_func free_value;
     elem_t *first;
     elem_t *last;
     int length;
+    bool pooled;
+    list_slab_t *slabs;
+    elem_t *free_elems;
+    int slab_used;          /**< elements handed out from the newest slab */
 };
 
 struct elem {
@@ -20,9 +34,15 @@ struct elem {
     elem_t *next;
 };
 
+struct list_slab {
+    list_slab_t *next;
+    int capacity;
+    elem_t elems[];
+};
+
 list_t *list_new(list_compare_func cmp, list_free_func free_value)
 {
-    list_t *list = calloc(1, sizeof(list_t));
+    list_t *list = memory_calloc(MEMORY_LIST, 1, sizeof(list_t));
 
     if (list != NULL) {
         list->cmp = cmp;
@@ -32,17 +52,78 @@ list_t *list_new(list_compare_func cmp, list_free_func free_value)
     return list;
 }
 
-elem_t *elem_new(void *value)
+list_t *list_new_pooled(list_compare_func cmp, list_free_func free_value)
+{
+    list_t *list = list_new(cmp, free_value);
+
+    if (list != NULL) {
+        list->pooled = true;
+    }
+
+    return list;
+}
+
+/**
+ * Take an unused element from the list's slabs.
+ * @param list pooled list
+ * @return the element, NULL if a new slab could not be allocated
+ */
+elem_t *list_pool_take(list_t *list)
 {
-    elem_t *elem = calloc(1, sizeof(elem_t));
+    if (list->free_elems != NULL) {
+        elem_t *elem = list->free_elems;
+        list->free_elems = elem->next;
+        return elem;
+    }
+
+    if (list->slabs == NULL || list->slab_used == list->slabs->capacity) {
+        int capacity = (list->slabs == NULL) ? LIST_SLAB_MIN : 2 * list->slabs->capacity;
+        if (capacity > LIST_SLAB_MAX)
+            capacity = LIST_SLAB_MAX;
+
+        list_slab_t *slab = memory_malloc(MEMORY_LIST,
+                                          sizeof(list_slab_t) + capacity * sizeof(elem_t));
+        if (slab == NULL)
+            return NULL;
+
+        slab->next = list->slabs;
+        slab->capacity = capacity;
+        list->slabs = slab;
+        list->slab_used = 0;
+    }
+
+    return &list->slabs->elems[list->slab_used++];
+}
+
+elem_t *elem_new(list_t *list, void *value)
+{
+    elem_t *elem;
+
+    if (list->pooled) {
+        elem = list_pool_take(list);
+    } else {
+        elem = memory_malloc(MEMORY_LIST, sizeof(elem_t));
+    }
 
     if (elem != NULL) {
         elem->value = value;
+        elem->prev = NULL;
+        elem->next = NULL;
     }
 
     return elem;
 }
 
+void elem_free(list_t *list, elem_t *elem)
+{
+    if (list->pooled) {
+        elem->next = list->free_elems;
+        list->free_elems = elem;
+    } else {
+        memory_free(MEMORY_LIST, elem);
+    }
+}
+
 elem_t *list_get_element(list_t *list, int index)
 {
     elem_t *current = list->first;
@@ -62,7 +143,7 @@ elem_t *list_get_element(list_t *list, int index)
 
 void list_append(list_t *list, void *value)
 {
-    elem_t *new = elem_new(value);
+    elem_t *new = elem_new(list, value);
 
     if (list->first == NULL) {
         list->first = new;
@@ -82,7 +163,7 @@ void list_prepend(list_t *list, void *value)
     if (list->last == NULL) {
         list_append(list, value);
     } else {
-        elem_t *new = elem_new(value);
+        elem_t *new = elem_new(list, value);
         new->next = list->first;
         list->first->prev = new;
         list->first = new;
@@ -100,7 +181,7 @@ bool list_insert(list_t *list, int index, void *value)
         elem_t *current = list_get_element(list, index);
 
         if (current != NULL) {
-            elem_t *new = elem_new(value);
+            elem_t *new = elem_new(list, value);
             new->prev = current->prev;
             new->next = current;
 
@@ -146,7 +227,7 @@ bool _list_remove_element(list_t *list, elem_t *current)
         list->first = current->next;
     }
 
-    free(current);
+    elem_free(list, current);
     list->length--;
     return true;
 }
@@ -213,7 +294,7 @@ void list_clear(list_t *list)
         elem_t *temp = current;
         list->free_value(temp->value);
         current = current->next;
-        free(temp);
+        elem_free(list, temp);
     }
 
     list->first = NULL;
@@ -347,9 +428,19 @@ void list_free(list_t *list)
             temp = current;
             current = current->next;
             list->free_value(temp->value);
-            free(temp);
+
+            // pooled elements go away with their slabs
+            if (!list->pooled) {
+                memory_free(MEMORY_LIST, temp);
+            }
+        }
+
+        while (list->slabs != NULL) {
+            list_slab_t *slab = list->slabs;
+            list->slabs = slab->next;
+            memory_free(MEMORY_LIST, slab);
         }
 
-        free(list);
+        memory_free(MEMORY_LIST, list);
     }
 }
@@ -32,6 +32,16 @@ typedef void(*list_free_func)(void *);
  */
 list_t *list_new(list_compare_func cmp, list_free_func free_value);
 
+/**
+ * Create a new linked list whose elements come from slabs owned by the
+ * list instead of one allocation each. Removed elements are reused, and
+ * the memory is returned when the list is freed.
+ * @param cmp fpointer to compare list values
+ * @param free_value fpointer to free list values
+ * @return the new list.
+ */
+list_t *list_new_pooled(list_compare_func cmp, list_free_func free_value);
+
 /**
  * Add value to the end of the list.
  * @param list list to append to
@@ -1,8 +1,32 @@
 #include <argp.h>
+#include <ctype.h>
+#include <endian.h>
+#include <errno.h>
 #include <error.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "aio.h"
 #include "huffman.h"
+#include "memory.h"
+#include "stats.h"
+#include "trace.h"
+
+#define IO_CHUNK_SIZE (1 << 20)
+#define IO_QUEUE_DEPTH 8
+
+enum {
+    OPT_IO = 256,
+    OPT_SYNC,
+    OPT_THREADS,
+    OPT_STATS,
+    OPT_TRACE
+};
 
 const char *argp_program_version =
     "huffman 0.1";
@@ -19,6 +43,12 @@ static struct argp_option options[] = {
     {"verbose",  'v', 0,       0, "Produce verbose output" },
     {"output",   'o', "FILE",  0, "Output bits to FILE" },
     {"input",     'i', "FILE",  0, "Read Huffman tree and data from FILE"},
+    {"io",    OPT_IO, "BACKEND", 0, "I/O backend: auto, uring or threads" },
+    {"sync",  OPT_SYNC, "K",     0, "Record a sync point every K symbols for seeking" },
+    {"threads", OPT_THREADS, "N", 0, "Decode with N threads" },
+    {"stats", OPT_STATS, "FORMAT", OPTION_ARG_OPTIONAL,
+        "Print statistics to stderr as text (default) or json" },
+    {"trace", OPT_TRACE, "FILE", 0, "Write a Chrome trace-event timeline to FILE" },
 
     { 0 }
 };
@@ -30,11 +60,32 @@ struct arguments
     int verbose;         /* ‘-s’, ‘-v’, ‘--abort’ */
     char *output_file;   /* file arg to ‘--output’ */
     char *input_file;
+    aio_backend_t io_backend;
+    unsigned int sync_interval;
+    int threads;
+    int stats;           /* 0 off, 1 text, 2 json */
+    char *trace_file;
+    memory_accounting_t *memory;
 };
 
+// Parse a decimal number no larger than max, false on signs, junk or overflow
+static bool parse_number(const char *arg, unsigned long max, unsigned long *value)
+{
+    char *end;
+
+    if (!isdigit((unsigned char) arg[0]))
+        return false;
+
+    errno = 0;
+    *value = strtoul(arg, &end, 10);
+
+    return errno == 0 && *end == '\0' && *value <= max;
+}
+
 static error_t parse_opt (int key, char *arg, struct argp_state *state)
 {
     struct arguments *arguments = state->input;
+    unsigned long number;
 
     switch (key) {
         case 'v':
@@ -46,6 +97,37 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
         case 'i':
             arguments->input_file = arg;
             break;
+        case OPT_IO:
+            if (strcmp(arg, "auto") == 0)
+                arguments->io_backend = AIO_AUTO;
+            else if (strcmp(arg, "uring") == 0)
+                arguments->io_backend = AIO_URING;
+            else if (strcmp(arg, "threads") == 0)
+                arguments->io_backend = AIO_THREADS;
+            else
+                argp_error(state, "unknown I/O backend '%s'", arg);
+            break;
+        case OPT_SYNC:
+            if (!parse_number(arg, UINT_MAX, &number))
+                argp_error(state, "invalid sync interval '%s'", arg);
+            arguments->sync_interval = number;
+            break;
+        case OPT_STATS:
+            if (arg == NULL || strcmp(arg, "text") == 0)
+                arguments->stats = 1;
+            else if (strcmp(arg, "json") == 0)
+                arguments->stats = 2;
+            else
+                argp_error(state, "unknown statistics format '%s'", arg);
+            break;
+        case OPT_TRACE:
+            arguments->trace_file = arg;
+            break;
+        case OPT_THREADS:
+            if (!parse_number(arg, INT_MAX, &number) || number < 1)
+                argp_error(state, "invalid thread count '%s'", arg);
+            arguments->threads = number;
+            break;
         case ARGP_KEY_NO_ARGS:
             argp_usage(state);
         case ARGP_KEY_ARG:
@@ -66,98 +148,319 @@ static error_t parse_opt (int key, char *arg, struct argp_state *state)
 
 static struct argp argp = { options, parse_opt, args_doc, doc  };
 
+aio_t *io_open(struct arguments *arguments)
+{
+    aio_t *aio = aio_new(arguments->io_backend, IO_QUEUE_DEPTH);
+
+    if (aio == NULL)
+        error(10, 0, "FAILED TO INITIALIZE I/O BACKEND");
+
+    if (arguments->verbose)
+        printf("I/O backend: %s\n", aio_backend_name(aio));
+
+    return aio;
+}
+
+// Time a stage in the statistics and the trace timeline.
+void stage_begin(stats_t *stats, stats_stage_t stage, long block)
+{
+    trace_begin(stats_stage_name(stage), block);
+    stats_begin(stats);
+}
+
+void stage_end(stats_t *stats, stats_stage_t stage, long block)
+{
+    stats_end(stats, stage);
+    trace_end(stats_stage_name(stage), block);
+}
+
+// Wait for the next request to complete, aborting on I/O errors.
+void io_complete(aio_t *aio)
+{
+    void *data;
+
+    trace_begin("io_wait", -1);
+    ssize_t result = aio_wait(aio, &data);
+    trace_end("io_wait", -1);
+
+    if (result < 0)
+        error(10, -result, "I/O ERROR");
+}
+
+void io_drain(aio_t *aio)
+{
+    while (aio_pending(aio) > 0)
+        io_complete(aio);
+}
+
+// Queue a write in chunks, waiting for earlier requests when the queue is full.
+void io_write(aio_t *aio, int fd, const void *buf, size_t length, off_t offset)
+{
+    for (size_t done = 0; done < length; done += IO_CHUNK_SIZE) {
+        size_t chunk = (length - done < IO_CHUNK_SIZE) ? length - done : IO_CHUNK_SIZE;
+
+        while (!aio_write(aio, fd, (const char *) buf + done, chunk, offset + done, NULL))
+            io_complete(aio);
+    }
+}
+
+// Read an entire file with several chunks in flight and null terminate it.
+char *io_read_file(aio_t *aio, const char *path, size_t *size)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    char *buf = memory_malloc(MEMORY_OTHER, st.st_size + 1);
+
+    for (off_t offset = 0; buf != NULL && offset < st.st_size; offset += IO_CHUNK_SIZE) {
+        size_t chunk = (st.st_size - offset < IO_CHUNK_SIZE) ? st.st_size - offset : IO_CHUNK_SIZE;
+
+        while (!aio_read(aio, fd, buf + offset, chunk, offset, NULL))
+            io_complete(aio);
+    }
+
+    io_drain(aio);
+    close(fd);
+
+    if (buf != NULL) {
+        buf[st.st_size] = '\0';
+        *size = st.st_size;
+    }
+
+    return buf;
+}
+
 void encode(struct arguments *arguments, char *message)
 {
     int tree_size = 0;
     int unique_letters = 0;
+    int fd = -1;
+    uint64_t freq[256] = { 0 };
+    aio_t *aio = io_open(arguments);
+    stats_t stats;
+
+    stats_init(&stats, NULL, NULL);
+    stats.memory = arguments->memory;
 
     if (arguments->input_file) {
-        FILE *input = fopen(arguments->input_file, "r");
+        size_t size;
 
-        if (input == NULL) error(10, 0, "ERROR LOADING INPUT FILE");
+        memory_free(MEMORY_OTHER, message);
+        stage_begin(&stats, STATS_READ, -1);
+        message = io_read_file(aio, arguments->input_file, &size);
+        stage_end(&stats, STATS_READ, -1);
 
-        fseek(input, 0L, SEEK_END);
-        int size = ftell(input);
-        rewind(input);
+        if (message == NULL) error(10, 0, "ERROR LOADING INPUT FILE");
 
-        free(message);
-        message = malloc((size + 1) * sizeof(char));
-        fread(message, sizeof(char), size, input);
+        stats.bytes_in = size;
+    }
 
-        message[size] = '\0';
+    size_t length = strlen(message);
 
-        fclose(input);
-    }
+    stage_begin(&stats, STATS_HISTOGRAM, -1);
+    huffman_count(message, length, freq);
+    stage_end(&stats, STATS_HISTOGRAM, -1);
+
+    stage_begin(&stats, STATS_TREE, -1);
+    huffman_node_t *root = huffman_new_tree_counts(freq, &tree_size, &unique_letters);
+    bit_array_t *tree_bits = huffman_encode_tree(root, tree_size, unique_letters);
+    stage_end(&stats, STATS_TREE, -1);
 
-    huffman_node_t *root = huffman_new_tree(message, &tree_size, &unique_letters);
+    stage_begin(&stats, STATS_TABLE, -1);
     char **index = huffman_build_index(root);
+    stats.table_rebuilds++;
+    stage_end(&stats, STATS_TABLE, -1);
 
-    bit_array_t *bits = huffman_encode(index, message);
-    bit_array_t *tree_bits = huffman_encode_tree(root, tree_size, unique_letters);
+    bit_array_t *bits = bit_array_new(huffman_encoded_length(index, message, length));
 
-    int msg_len = bit_array_length(bits);
-    int tree_len = bit_array_length(tree_bits);
+    uint64_t msg_len = bit_array_length(bits);
+    uint64_t tree_len = bit_array_length(tree_bits);
+    size_t msg_bytes = (msg_len + 7) / 8;
+    size_t tree_bytes = (tree_len + 7) / 8;
+    off_t tree_offset = HUFFMAN_HEADER_SIZE + sizeof(tree_len);
+    off_t msg_offset = tree_offset + tree_bytes + sizeof(msg_len);
 
-    if (arguments->verbose) {
-        printf("Message (%d bits): %s\n", 8 * (int) strlen(message), message);
-        printf("Binary (%d bits):  ", msg_len); bit_array_print(bits); puts("");
-        printf("Tree (%d bits):  ", tree_len); bit_array_print(tree_bits); puts("");
-    }
+    // length fields are stored little-endian
+    uint8_t header[HUFFMAN_HEADER_SIZE];
+    uint64_t tree_header = htole64(tree_len);
+    uint64_t msg_header = htole64(msg_len);
 
-    float percent = 1 - (msg_len + tree_len) / (float) (8 * strlen(message));
-    printf("Compression: %.1f%%\n", 100 * percent);
+    huffman_header_encode(header);
 
     if (arguments->output_file) {
         printf("Writing tree and message bits to file: %s\n", arguments->output_file);
 
-        FILE *file = fopen(arguments->output_file, "w");
+        fd = open(arguments->output_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 
-        if (file == NULL)
+        if (fd < 0)
             error(10, 0, "FAILED TO OPEN OUTPUT FILE");
 
-        bit_array_write(tree_bits, file);
-        bit_array_write(bits, file);
+        // the file header, then the layout of bit_array_write() of the tree and the message
+        io_write(aio, fd, header, sizeof(header), 0);
+        io_write(aio, fd, &tree_header, sizeof(tree_header), tree_offset - sizeof(tree_header));
+        io_write(aio, fd, bit_array_data(tree_bits), tree_bytes, tree_offset);
+        io_write(aio, fd, &msg_header, sizeof(msg_header), msg_offset - sizeof(msg_header));
+    }
 
-        fclose(file);
+    // encode chunk by chunk and write out completed bytes while encoding the rest
+    uint64_t pos = 0;
+    size_t written = 0;
+    uint8_t *data = bit_array_data(bits);
+
+    for (size_t start = 0; start < length; start += IO_CHUNK_SIZE) {
+        size_t end = (length - start < IO_CHUNK_SIZE) ? length : start + IO_CHUNK_SIZE;
+
+        stage_begin(&stats, STATS_ENCODE, start / IO_CHUNK_SIZE);
+        huffman_encode_range(index, message, start, end, bits, &pos);
+        stats.blocks++;
+        stage_end(&stats, STATS_ENCODE, start / IO_CHUNK_SIZE);
+
+        if (fd >= 0 && pos / 8 > written) {
+            stage_begin(&stats, STATS_WRITE, start / IO_CHUNK_SIZE);
+            io_write(aio, fd, data + written, pos / 8 - written, msg_offset + written);
+            written = pos / 8;
+            stage_end(&stats, STATS_WRITE, start / IO_CHUNK_SIZE);
+        }
+    }
+
+    stats.symbols = length;
+    stats.encoded_bits = msg_len;
+    stats.entropy = stats_entropy(freq);
+
+    bit_array_t *sync_bits = NULL;
+    uint64_t sync_len = 0;
+    uint64_t sync_header = 0;
+
+    if (fd >= 0) {
+        stage_begin(&stats, STATS_WRITE, -1);
+        io_write(aio, fd, data + written, msg_bytes - written, msg_offset + written);
+        stats.bytes_out = msg_offset + msg_bytes;
+
+        if (arguments->sync_interval > 0) {
+            huffman_sync_t *sync = huffman_sync_new(index, message, length,
+                                                    arguments->sync_interval);
+            sync_bits = huffman_sync_encode(sync);
+            sync_len = bit_array_length(sync_bits);
+            huffman_sync_free(sync);
+
+            off_t sync_offset = msg_offset + msg_bytes;
+            sync_header = htole64(sync_len);
+            io_write(aio, fd, &sync_header, sizeof(sync_header), sync_offset);
+            io_write(aio, fd, bit_array_data(sync_bits), (sync_len + 7) / 8,
+                     sync_offset + sizeof(sync_len));
+            stats.bytes_out += sizeof(sync_len) + (sync_len + 7) / 8;
+        }
+
+        io_drain(aio);
+        close(fd);
+        stage_end(&stats, STATS_WRITE, -1);
+    }
+
+    if (arguments->verbose) {
+        printf("Message (%" PRIu64 " bits): %s\n", 8 * (uint64_t) length, message);
+        printf("Binary (%" PRIu64 " bits):  ", msg_len); bit_array_print(bits); puts("");
+        printf("Tree (%" PRIu64 " bits):  ", tree_len); bit_array_print(tree_bits); puts("");
     }
 
-    free(message);
+    float percent = 1 - (msg_len + tree_len) / (float) (8 * length);
+    printf("Compression: %.1f%%\n", 100 * percent);
+
+    if (arguments->stats)
+        stats_print(&stats, stderr, arguments->stats == 2);
+
+    memory_free(MEMORY_OTHER, message);
 
     huffman_free(root, index);
 
     bit_array_free(bits);
     bit_array_free(tree_bits);
+    if (sync_bits != NULL)
+        bit_array_free(sync_bits);
+    aio_free(aio);
 }
 
 void decode(struct arguments *arguments, char *message)
 {
     char *output = NULL;
+    aio_t *aio = io_open(arguments);
+    stats_t stats;
+
+    stats_init(&stats, NULL, NULL);
+    stats.memory = arguments->memory;
 
     if (arguments->input_file) {
         printf("Reading Huffman tree from file: %s\n", arguments->input_file);
 
-        FILE *file = fopen(arguments->input_file, "r");
+        size_t size;
+        stage_begin(&stats, STATS_READ, -1);
+        char *buf = io_read_file(aio, arguments->input_file, &size);
+
+        if (buf == NULL)
+            error(10, 0, "FAILED TO READ TREE FILE");
+
+        FILE *file = fmemopen(buf, size, "r");
 
         if (file == NULL)
             error(10, 0, "FAILED TO READ TREE FILE");
 
-        bit_array_t *tree_bits = bit_array_read(file);
-        bit_array_t *bits = bit_array_read(file);
+        uint32_t version = huffman_header_version((uint8_t *) buf, size);
+        bit_array_t *tree_bits = NULL;
+        bit_array_t *bits = NULL;
+
+        // legacy files have no header and 32-bit lengths
+        if (version == HUFFMAN_VERSION_LEGACY) {
+            tree_bits = bit_array_read_legacy(file);
+            bits = bit_array_read_legacy(file);
+        } else if (version == HUFFMAN_VERSION) {
+            fseek(file, HUFFMAN_HEADER_SIZE, SEEK_SET);
+            tree_bits = bit_array_read(file);
+            bits = bit_array_read(file);
+        } else {
+            error(10, 0, "UNSUPPORTED FILE VERSION");
+        }
+
+        if (tree_bits == NULL || bits == NULL)
+            error(10, 0, "INVALID INPUT FILE");
+
+        fclose(file);
+        memory_free(MEMORY_OTHER, buf);
+        stage_end(&stats, STATS_READ, -1);
+        stats.bytes_in = size;
 
         if (arguments->verbose) {
             printf("Tree:  "); bit_array_print(tree_bits); puts("");
             printf("Bits:  "); bit_array_print(bits); puts("");
         }
 
+        stage_begin(&stats, STATS_TREE, -1);
         huffman_node_t *root = huffman_build_tree(tree_bits);
+        stage_end(&stats, STATS_TREE, -1);
 
-        output = huffman_decode(root, bits);
+        if (root == NULL)
+            error(10, 0, "INVALID INPUT FILE");
+
+        stage_begin(&stats, STATS_DECODE, -1);
+        output = huffman_decode_parallel(root, bits, arguments->threads);
+        stage_end(&stats, STATS_DECODE, -1);
+
+        if (output == NULL)
+            error(10, 0, "FAILED TO DECODE");
+
+        stats.blocks = 1;
+        stats.symbols = strlen(output);
+        stats.encoded_bits = bit_array_length(bits);
 
         huffman_free(root, NULL);
         bit_array_free(tree_bits);
         bit_array_free(bits);
-
-        fclose(file);
     }
 
     if (arguments->verbose) {
@@ -165,15 +468,25 @@ void decode(struct arguments *arguments, char *message)
     }
 
     if (arguments->output_file) {
-        FILE *out_file = fopen(arguments->output_file, "w");
+        int fd = open(arguments->output_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 
-        fwrite(output, sizeof(char), strlen(output), out_file);
+        if (fd < 0)
+            error(10, 0, "FAILED TO OPEN OUTPUT FILE");
 
-        fclose(out_file);
+        stage_begin(&stats, STATS_WRITE, -1);
+        io_write(aio, fd, output, strlen(output), 0);
+        io_drain(aio);
+        close(fd);
+        stage_end(&stats, STATS_WRITE, -1);
+        stats.bytes_out = strlen(output);
     }
 
-    free(message);
-    free(output);
+    if (arguments->stats)
+        stats_print(&stats, stderr, arguments->stats == 2);
+
+    memory_free(MEMORY_OTHER, message);
+    memory_free(MEMORY_HUFFMAN, output);
+    aio_free(aio);
 }
 
 int main(int argc, char **argv)
@@ -184,9 +497,30 @@ int main(int argc, char **argv)
     arguments.verbose = 0;
     arguments.output_file = NULL;
     arguments.input_file = NULL;
+    arguments.io_backend = AIO_AUTO;
+    arguments.sync_interval = 0;
+    arguments.threads = 1;
+    arguments.stats = 0;
+    arguments.trace_file = NULL;
 
     argp_parse(&argp, argc, argv, 0, 0, &arguments);
 
+    // account allocations per subsystem for the statistics
+    arguments.memory = NULL;
+    if (arguments.stats) {
+        arguments.memory = memory_accounting_new(NULL, 0);
+
+        if (arguments.memory == NULL)
+            error(10, 0, "OUT OF MEMORY");
+
+        allocator_t allocator = memory_accounting_allocator(arguments.memory);
+        memory_set_allocator(&allocator);
+    }
+
+    // started after the allocator is installed since its buffers are freed at exit
+    if (arguments.trace_file != NULL && !trace_start(arguments.trace_file))
+        error(10, 0, "FAILED TO START TRACE");
+
     // concat message
     int length = 0;
     int num_words = 0;
@@ -198,7 +532,7 @@ int main(int argc, char **argv)
     if (length == 0 && arguments.input_file == NULL) error(10, 0, "NO INPUT");
 
     int index = 0;
-    char *message = calloc(length + 1, sizeof(char));
+    char *message = memory_calloc(MEMORY_OTHER, length + 1, sizeof(char));
     for (int i = 0; arguments.words[i]; i++) {
         for (int j = 0; j < strlen(arguments.words[i]); j++)
             message[index++] = arguments.words[i][j];
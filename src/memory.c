@@ -0,0 +1,369 @@
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+
+/**
+ * Header stored in front of every allocation made by the accounting
+ * allocator, padded so the memory after it stays suitably aligned.
+ */
+typedef union accounting_header {
+    struct {
+        size_t size;
+        memory_subsystem_t subsystem;
+        unsigned int padding;   /**< bytes in front of the header to align the memory */
+    };
+    max_align_t align;
+} accounting_header_t;
+
+typedef struct accounting_usage {
+    atomic_size_t current;
+    atomic_size_t peak;
+    atomic_size_t allocations;
+    atomic_size_t frees;
+} accounting_usage_t;
+
+struct memory_accounting {
+    allocator_t backing;
+    size_t limit;
+    // one entry per subsystem followed by the total
+    accounting_usage_t usage[MEMORY_NUM_SUBSYSTEMS + 1];
+};
+
+static const char *subsystem_names[MEMORY_NUM_SUBSYSTEMS] = {
+    "other", "huffman", "bit_array", "bit_index", "heap", "list", "tree", "stack", "iter", "reader",
+    "aio", "trace"
+};
+
+static void *libc_malloc(void *context, memory_subsystem_t subsystem, size_t size)
+{
+    return malloc(size);
+}
+
+static void *libc_calloc(void *context, memory_subsystem_t subsystem, size_t count, size_t size)
+{
+    return calloc(count, size);
+}
+
+static void *libc_realloc(void *context, memory_subsystem_t subsystem, void *ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+static void *libc_aligned_alloc(void *context, memory_subsystem_t subsystem, size_t alignment,
+                                size_t size)
+{
+    void *ptr;
+    return (posix_memalign(&ptr, alignment, size) == 0) ? ptr : NULL;
+}
+
+static void libc_free(void *context, memory_subsystem_t subsystem, void *ptr)
+{
+    free(ptr);
+}
+
+static const allocator_t libc_allocator = {
+    libc_malloc, libc_calloc, libc_realloc, libc_aligned_alloc, libc_free, NULL
+};
+
+static allocator_t allocator = {
+    libc_malloc, libc_calloc, libc_realloc, libc_aligned_alloc, libc_free, NULL
+};
+
+void memory_set_allocator(const allocator_t *hooks)
+{
+    allocator = (hooks != NULL) ? *hooks : libc_allocator;
+}
+
+const allocator_t *memory_get_allocator()
+{
+    return &allocator;
+}
+
+void *memory_malloc(memory_subsystem_t subsystem, size_t size)
+{
+    return allocator.malloc(allocator.context, subsystem, size);
+}
+
+void *memory_calloc(memory_subsystem_t subsystem, size_t count, size_t size)
+{
+    return allocator.calloc(allocator.context, subsystem, count, size);
+}
+
+void *memory_realloc(memory_subsystem_t subsystem, void *ptr, size_t size)
+{
+    return allocator.realloc(allocator.context, subsystem, ptr, size);
+}
+
+void *memory_aligned_alloc(memory_subsystem_t subsystem, size_t alignment, size_t size)
+{
+    return allocator.aligned_alloc(allocator.context, subsystem, alignment, size);
+}
+
+char *memory_strdup(memory_subsystem_t subsystem, const char *str)
+{
+    size_t size = strlen(str) + 1;
+    char *copy = memory_malloc(subsystem, size);
+
+    if (copy != NULL)
+        memcpy(copy, str, size);
+
+    return copy;
+}
+
+void memory_free(memory_subsystem_t subsystem, void *ptr)
+{
+    if (ptr != NULL)
+        allocator.free(allocator.context, subsystem, ptr);
+}
+
+const char *memory_subsystem_name(memory_subsystem_t subsystem)
+{
+    return (subsystem < MEMORY_NUM_SUBSYSTEMS) ? subsystem_names[subsystem] : "total";
+}
+
+// Reserve size bytes, false if that would exceed the limit
+bool accounting_reserve(memory_accounting_t *accounting, size_t size)
+{
+    accounting_usage_t *total = &accounting->usage[MEMORY_NUM_SUBSYSTEMS];
+    size_t current = atomic_fetch_add(&total->current, size) + size;
+
+    if (accounting->limit > 0 && current > accounting->limit) {
+        atomic_fetch_sub(&total->current, size);
+        return false;
+    }
+
+    return true;
+}
+
+void accounting_release(memory_accounting_t *accounting, size_t size)
+{
+    atomic_fetch_sub(&accounting->usage[MEMORY_NUM_SUBSYSTEMS].current, size);
+}
+
+void accounting_update_peak(accounting_usage_t *usage, size_t current)
+{
+    size_t peak = atomic_load(&usage->peak);
+    while (current > peak && !atomic_compare_exchange_weak(&usage->peak, &peak, current))
+        ;
+}
+
+// Record size bytes allocated, the total having been reserved already
+void accounting_add(memory_accounting_t *accounting, memory_subsystem_t subsystem, size_t size)
+{
+    accounting_usage_t *usage = &accounting->usage[subsystem];
+    accounting_usage_t *total = &accounting->usage[MEMORY_NUM_SUBSYSTEMS];
+
+    accounting_update_peak(usage, atomic_fetch_add(&usage->current, size) + size);
+    accounting_update_peak(total, atomic_load(&total->current));
+    atomic_fetch_add(&usage->allocations, 1);
+    atomic_fetch_add(&total->allocations, 1);
+}
+
+void accounting_sub(memory_accounting_t *accounting, memory_subsystem_t subsystem, size_t size)
+{
+    atomic_fetch_sub(&accounting->usage[subsystem].current, size);
+    atomic_fetch_sub(&accounting->usage[MEMORY_NUM_SUBSYSTEMS].current, size);
+}
+
+void *accounting_malloc(void *context, memory_subsystem_t subsystem, size_t size)
+{
+    memory_accounting_t *accounting = context;
+    accounting_header_t *header;
+
+    if (size > SIZE_MAX - sizeof(accounting_header_t) || !accounting_reserve(accounting, size))
+        return NULL;
+
+    header = accounting->backing.malloc(accounting->backing.context, subsystem,
+                                        sizeof(accounting_header_t) + size);
+    if (header == NULL) {
+        accounting_release(accounting, size);
+        return NULL;
+    }
+
+    header->size = size;
+    header->subsystem = subsystem;
+    header->padding = 0;
+    accounting_add(accounting, subsystem, size);
+
+    return header + 1;
+}
+
+void *accounting_calloc(void *context, memory_subsystem_t subsystem, size_t count, size_t size)
+{
+    memory_accounting_t *accounting = context;
+    accounting_header_t *header;
+
+    if (size > 0 && count > (SIZE_MAX - sizeof(accounting_header_t)) / size)
+        return NULL;
+
+    size *= count;
+    if (!accounting_reserve(accounting, size))
+        return NULL;
+
+    // let the backing calloc zero the memory so large blocks stay lazily mapped
+    header = accounting->backing.calloc(accounting->backing.context, subsystem, 1,
+                                        sizeof(accounting_header_t) + size);
+    if (header == NULL) {
+        accounting_release(accounting, size);
+        return NULL;
+    }
+
+    header->size = size;
+    header->subsystem = subsystem;
+    header->padding = 0;
+    accounting_add(accounting, subsystem, size);
+
+    return header + 1;
+}
+
+void *accounting_aligned_alloc(void *context, memory_subsystem_t subsystem, size_t alignment,
+                               size_t size)
+{
+    memory_accounting_t *accounting = context;
+
+    // the header goes right in front of the memory, in a gap that keeps it aligned
+    size_t offset = (alignment > sizeof(accounting_header_t)) ? alignment
+                                                               : sizeof(accounting_header_t);
+
+    if (offset > UINT_MAX || size > SIZE_MAX - offset || !accounting_reserve(accounting, size))
+        return NULL;
+
+    char *block = accounting->backing.aligned_alloc(accounting->backing.context, subsystem,
+                                                    offset, offset + size);
+    if (block == NULL) {
+        accounting_release(accounting, size);
+        return NULL;
+    }
+
+    accounting_header_t *header = (accounting_header_t *) (block + offset) - 1;
+    header->size = size;
+    header->subsystem = subsystem;
+    header->padding = offset - sizeof(accounting_header_t);
+    accounting_add(accounting, subsystem, size);
+
+    return header + 1;
+}
+
+void *accounting_realloc(void *context, memory_subsystem_t subsystem, void *ptr, size_t size)
+{
+    memory_accounting_t *accounting = context;
+
+    if (ptr == NULL)
+        return accounting_malloc(context, subsystem, size);
+
+    accounting_header_t *header = (accounting_header_t *) ptr - 1;
+    size_t old_size = header->size;
+    memory_subsystem_t owner = header->subsystem;
+
+    if (size > SIZE_MAX - sizeof(accounting_header_t))
+        return NULL;
+
+    if (size > old_size && !accounting_reserve(accounting, size - old_size))
+        return NULL;
+
+    header = accounting->backing.realloc(accounting->backing.context, owner, header,
+                                         sizeof(accounting_header_t) + size);
+    if (header == NULL) {
+        if (size > old_size)
+            accounting_release(accounting, size - old_size);
+        return NULL;
+    }
+
+    header->size = size;
+
+    accounting_usage_t *usage = &accounting->usage[owner];
+    if (size > old_size) {
+        accounting_update_peak(usage, atomic_fetch_add(&usage->current, size - old_size)
+                               + size - old_size);
+        accounting_update_peak(&accounting->usage[MEMORY_NUM_SUBSYSTEMS],
+                               atomic_load(&accounting->usage[MEMORY_NUM_SUBSYSTEMS].current));
+    } else {
+        accounting_sub(accounting, owner, old_size - size);
+    }
+
+    return header + 1;
+}
+
+void accounting_free(void *context, memory_subsystem_t subsystem, void *ptr)
+{
+    memory_accounting_t *accounting = context;
+    accounting_header_t *header = (accounting_header_t *) ptr - 1;
+
+    // memory is accounted to the subsystem that allocated it
+    accounting_sub(accounting, header->subsystem, header->size);
+    atomic_fetch_add(&accounting->usage[header->subsystem].frees, 1);
+    atomic_fetch_add(&accounting->usage[MEMORY_NUM_SUBSYSTEMS].frees, 1);
+
+    accounting->backing.free(accounting->backing.context, header->subsystem,
+                             (char *) header - header->padding);
+}
+
+memory_accounting_t *memory_accounting_new(const allocator_t *backing, size_t limit)
+{
+    memory_accounting_t *accounting = calloc(1, sizeof(memory_accounting_t));
+
+    if (accounting != NULL) {
+        accounting->backing = (backing != NULL) ? *backing : libc_allocator;
+        accounting->limit = limit;
+    }
+
+    return accounting;
+}
+
+allocator_t memory_accounting_allocator(memory_accounting_t *accounting)
+{
+    return (allocator_t) {
+        accounting_malloc, accounting_calloc, accounting_realloc, accounting_aligned_alloc,
+        accounting_free, accounting
+    };
+}
+
+void memory_accounting_usage(memory_accounting_t *accounting, memory_subsystem_t subsystem,
+                             memory_usage_t *usage)
+{
+    accounting_usage_t *source = &accounting->usage[subsystem];
+
+    usage->current = atomic_load(&source->current);
+    usage->peak = atomic_load(&source->peak);
+    usage->allocations = atomic_load(&source->allocations);
+    usage->frees = atomic_load(&source->frees);
+}
+
+void memory_accounting_print(memory_accounting_t *accounting, FILE *file, bool json)
+{
+    memory_usage_t usage;
+    bool first = true;
+
+    if (json)
+        fprintf(file, "{");
+    else
+        fprintf(file, "Subsystem    Peak (KiB)  Current (KiB)  Allocations\n");
+
+    for (int i = 0; i <= MEMORY_NUM_SUBSYSTEMS; i++) {
+        memory_accounting_usage(accounting, i, &usage);
+
+        if (usage.allocations == 0)
+            continue;
+
+        if (json) {
+            fprintf(file, "%s\"%s\": {\"current\": %zu, \"peak\": %zu, \"allocations\": %zu, "
+                    "\"frees\": %zu}", first ? "" : ", ", memory_subsystem_name(i),
+                    usage.current, usage.peak, usage.allocations, usage.frees);
+        } else {
+            fprintf(file, "%-10s %12.1f %14.1f %12zu\n", memory_subsystem_name(i),
+                    usage.peak / 1024.0, usage.current / 1024.0, usage.allocations);
+        }
+        first = false;
+    }
+
+    if (json)
+        fprintf(file, "}");
+}
+
+void memory_accounting_free(memory_accounting_t *accounting)
+{
+    free(accounting);
+}
@@ -0,0 +1,177 @@
+/**
+ * Pluggable memory allocation.
+ *
+ * Every module allocates through memory_malloc() and friends, tagging each
+ * request with the subsystem it belongs to. The calls go to the allocator
+ * installed with memory_set_allocator(), which defaults to the C library.
+ * The accounting allocator wraps another allocator and tracks current and
+ * peak usage per subsystem, optionally failing requests over a budget.
+ * @file
+ */
+#ifndef __MEMORY_H__
+#define __MEMORY_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Subsystems memory is accounted to.
+ */
+typedef enum memory_subsystem {
+    MEMORY_OTHER,
+    MEMORY_HUFFMAN,
+    MEMORY_BIT_ARRAY,
+    MEMORY_BIT_INDEX,
+    MEMORY_HEAP,
+    MEMORY_LIST,
+    MEMORY_TREE,
+    MEMORY_STACK,
+    MEMORY_ITER,
+    MEMORY_READER,
+    MEMORY_AIO,
+    MEMORY_TRACE,
+    MEMORY_NUM_SUBSYSTEMS
+} memory_subsystem_t;
+
+/**
+ * Allocation hooks. Each hook gets the context pointer and the subsystem
+ * making the request; they behave like their C library counterparts, with
+ * aligned_alloc working like posix_memalign() but returning the memory.
+ */
+typedef struct allocator {
+    void *(*malloc)(void *context, memory_subsystem_t subsystem, size_t size);
+    void *(*calloc)(void *context, memory_subsystem_t subsystem, size_t count, size_t size);
+    void *(*realloc)(void *context, memory_subsystem_t subsystem, void *ptr, size_t size);
+    void *(*aligned_alloc)(void *context, memory_subsystem_t subsystem, size_t alignment,
+                           size_t size);
+    void (*free)(void *context, memory_subsystem_t subsystem, void *ptr);
+    void *context;
+} allocator_t;
+
+/**
+ * Memory usage of a subsystem.
+ */
+typedef struct memory_usage {
+    size_t current;         /**< bytes currently allocated */
+    size_t peak;            /**< most bytes allocated at once */
+    size_t allocations;     /**< number of successful allocations */
+    size_t frees;           /**< number of frees */
+} memory_usage_t;
+
+/**
+ * Accounting allocator type.
+ */
+typedef struct memory_accounting memory_accounting_t;
+
+/**
+ * Install the allocator used by all modules. Memory must be freed by the
+ * allocator that allocated it, so this should be called before anything
+ * is allocated or after everything has been freed.
+ * @param allocator hooks to use, copied; NULL restores the C library
+ */
+void memory_set_allocator(const allocator_t *allocator);
+
+/**
+ * Get the installed allocator.
+ * @return the hooks currently in use
+ */
+const allocator_t *memory_get_allocator();
+
+/**
+ * Allocate size bytes.
+ * @param subsystem subsystem making the request
+ * @param size number of bytes
+ * @return the memory, NULL on failure
+ */
+void *memory_malloc(memory_subsystem_t subsystem, size_t size);
+
+/**
+ * Allocate count zeroed elements of size bytes.
+ * @param subsystem subsystem making the request
+ * @param count number of elements
+ * @param size size of each element
+ * @return the memory, NULL on failure
+ */
+void *memory_calloc(memory_subsystem_t subsystem, size_t count, size_t size);
+
+/**
+ * Resize memory allocated by the same subsystem.
+ * @param subsystem subsystem making the request
+ * @param ptr memory to resize, may be NULL
+ * @param size new size in bytes
+ * @return the resized memory, NULL on failure in which case ptr is unchanged
+ */
+void *memory_realloc(memory_subsystem_t subsystem, void *ptr, size_t size);
+
+/**
+ * Allocate size bytes starting at a multiple of alignment. The memory is
+ * freed with memory_free() and cannot be resized.
+ * @param subsystem subsystem making the request
+ * @param alignment power of two that is a multiple of sizeof(void *)
+ * @param size number of bytes
+ * @return the memory, NULL on failure
+ */
+void *memory_aligned_alloc(memory_subsystem_t subsystem, size_t alignment, size_t size);
+
+/**
+ * Duplicate a string.
+ * @param subsystem subsystem making the request
+ * @param str string to copy
+ * @return the copy, NULL on failure
+ */
+char *memory_strdup(memory_subsystem_t subsystem, const char *str);
+
+/**
+ * Free memory allocated by the same subsystem.
+ * @param subsystem subsystem that allocated the memory
+ * @param ptr memory to free, may be NULL
+ */
+void memory_free(memory_subsystem_t subsystem, void *ptr);
+
+/**
+ * Get the name of a subsystem.
+ * @param subsystem subsystem to name
+ * @return the name
+ */
+const char *memory_subsystem_name(memory_subsystem_t subsystem);
+
+/**
+ * Create an accounting allocator. It is safe to use from several threads.
+ * @param backing allocator that serves the requests, NULL for the C library
+ * @param limit total bytes allowed at once, 0 for no limit
+ * @return the accounting allocator, NULL on failure
+ */
+memory_accounting_t *memory_accounting_new(const allocator_t *backing, size_t limit);
+
+/**
+ * Get hooks that allocate through an accounting allocator.
+ * @param accounting accounting allocator
+ * @return hooks to pass to memory_set_allocator()
+ */
+allocator_t memory_accounting_allocator(memory_accounting_t *accounting);
+
+/**
+ * Get the memory usage of a subsystem.
+ * @param accounting accounting allocator
+ * @param subsystem subsystem to check, MEMORY_NUM_SUBSYSTEMS for the total
+ * @param usage stores the usage
+ */
+void memory_accounting_usage(memory_accounting_t *accounting, memory_subsystem_t subsystem,
+                             memory_usage_t *usage);
+
+/**
+ * Print the usage of every subsystem that allocated memory.
+ * @param accounting accounting allocator
+ * @param file file to print to
+ * @param json print a JSON object instead of a table
+ */
+void memory_accounting_print(memory_accounting_t *accounting, FILE *file, bool json);
+
+/**
+ * Free an accounting allocator. It must no longer be installed.
+ * @param accounting accounting allocator to free
+ */
+void memory_accounting_free(memory_accounting_t *accounting);
+
+#endif //__MEMORY_H__
@@ -0,0 +1,222 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "multiqueue.h"
+#include "memory.h"
+
+#define CACHE_LINE 64
+#define MULTIQUEUE_TRY_LOCKS 4
+
+// each heap and its lock get a cache line of their own
+typedef struct shard {
+    pthread_mutex_t lock;
+    heap_t *heap;
+} __attribute__((aligned(CACHE_LINE))) shard_t;
+
+struct multiqueue {
+    int count;
+    int order;      /**< 1 for max-queues, -1 for min-queues */
+    heap_compare_func cmp;
+    shard_t *shards;
+    atomic_long size;
+};
+
+static __thread uint64_t random_state;
+
+// xorshift64, seeded per thread from the address of its state
+static int multiqueue_random(int range)
+{
+    if (random_state == 0)
+        random_state = (uintptr_t) &random_state | 1;
+
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 7;
+    random_state ^= random_state << 17;
+
+    return (int) (random_state % range);
+}
+
+multiqueue_t *multiqueue_new(int queues, heap_compare_func cmp, bool max)
+{
+    if (queues <= 0) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        queues = (processors > 0) ? 2 * processors : 2;
+    }
+
+    multiqueue_t *queue = memory_calloc(MEMORY_HEAP, 1, sizeof(multiqueue_t));
+    if (queue == NULL)
+        return NULL;
+
+    queue->order = max ? 1 : -1;
+    queue->cmp = cmp;
+    queue->shards = memory_aligned_alloc(MEMORY_HEAP, CACHE_LINE, queues * sizeof(shard_t));
+
+    if (queue->shards == NULL) {
+        multiqueue_free(queue);
+        return NULL;
+    }
+    memset(queue->shards, 0, queues * sizeof(shard_t));
+
+    for (; queue->count < queues; queue->count++) {
+        shard_t *shard = &queue->shards[queue->count];
+
+        shard->heap = max ? heap_new_max(0, cmp) : heap_new_min(0, cmp);
+        if (shard->heap == NULL) {
+            multiqueue_free(queue);
+            return NULL;
+        }
+        pthread_mutex_init(&shard->lock, NULL);
+    }
+
+    return queue;
+}
+
+int multiqueue_queues(multiqueue_t *queue)
+{
+    return queue->count;
+}
+
+long multiqueue_size(multiqueue_t *queue)
+{
+    return atomic_load(&queue->size);
+}
+
+bool multiqueue_insert(multiqueue_t *queue, void *value)
+{
+    shard_t *shard;
+    int tries = 0;
+
+    // move on to another heap instead of waiting for a busy one, a few times
+    do {
+        shard = &queue->shards[multiqueue_random(queue->count)];
+    } while (pthread_mutex_trylock(&shard->lock) != 0 && ++tries < MULTIQUEUE_TRY_LOCKS);
+
+    if (tries == MULTIQUEUE_TRY_LOCKS)
+        pthread_mutex_lock(&shard->lock);
+
+    bool inserted = heap_insert(shard->heap, value);
+    if (inserted)
+        atomic_fetch_add(&queue->size, 1);
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return inserted;
+}
+
+// Pick two random shards, the lower index first and the same one twice only with a single heap
+static void extract_pick(multiqueue_t *queue, shard_t **a, shard_t **b)
+{
+    int i = multiqueue_random(queue->count);
+    int j = (queue->count > 1) ? multiqueue_random(queue->count - 1) : i;
+
+    if (queue->count > 1 && j >= i)
+        j++;
+
+    *a = &queue->shards[(i < j) ? i : j];
+    *b = &queue->shards[(i < j) ? j : i];
+}
+
+// Lock two shards in index order, false if wait is unset and one of them is busy
+static bool extract_lock(shard_t *a, shard_t *b, bool wait)
+{
+    if (wait) {
+        pthread_mutex_lock(&a->lock);
+        if (b != a)
+            pthread_mutex_lock(&b->lock);
+        return true;
+    }
+
+    if (pthread_mutex_trylock(&a->lock) != 0)
+        return false;
+
+    if (b != a && pthread_mutex_trylock(&b->lock) != 0) {
+        pthread_mutex_unlock(&a->lock);
+        return false;
+    }
+
+    return true;
+}
+
+static void extract_unlock(shard_t *a, shard_t *b)
+{
+    if (b != a)
+        pthread_mutex_unlock(&b->lock);
+    pthread_mutex_unlock(&a->lock);
+}
+
+// Pick the shard with the better top, both locks being held
+static shard_t *extract_choose(multiqueue_t *queue, shard_t *a, shard_t *b)
+{
+    void *top_a = heap_get(a->heap, 0);
+    void *top_b = heap_get(b->heap, 0);
+
+    if (top_a == NULL || (top_b != NULL && queue->order * queue->cmp(top_b, top_a) > 0))
+        return b;
+
+    return a;
+}
+
+// Extract the top of a shard, the lock being held
+static void *shard_extract(multiqueue_t *queue, shard_t *shard)
+{
+    void *value = heap_extract(shard->heap);
+
+    if (value != NULL)
+        atomic_fetch_sub(&queue->size, 1);
+
+    return value;
+}
+
+void *multiqueue_extract(multiqueue_t *queue)
+{
+    void *value = NULL;
+    int empty = 0;
+    int busy = 0;
+
+    while (empty < queue->count && atomic_load(&queue->size) > 0) {
+        shard_t *a, *b;
+
+        // the tops are compared under both locks so neither can be extracted meanwhile,
+        // waiting for the heaps once others were busy too often
+        extract_pick(queue, &a, &b);
+        if (!extract_lock(a, b, busy >= MULTIQUEUE_TRY_LOCKS)) {
+            busy++;
+            continue;
+        }
+
+        value = shard_extract(queue, extract_choose(queue, a, b));
+        extract_unlock(a, b);
+
+        if (value != NULL)
+            return value;
+
+        empty++;
+    }
+
+    // the random heaps kept coming up empty, so look through all of them
+    for (int i = 0; i < queue->count && atomic_load(&queue->size) > 0; i++) {
+        shard_t *shard = &queue->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+        value = shard_extract(queue, shard);
+        pthread_mutex_unlock(&shard->lock);
+
+        if (value != NULL)
+            return value;
+    }
+
+    return NULL;
+}
+
+void multiqueue_free(multiqueue_t *queue)
+{
+    for (int i = 0; i < queue->count; i++) {
+        pthread_mutex_destroy(&queue->shards[i].lock);
+        heap_free(queue->shards[i].heap);
+    }
+
+    memory_free(MEMORY_HEAP, queue->shards);
+    memory_free(MEMORY_HEAP, queue);
+}
@@ -0,0 +1,70 @@
+/**
+ * Concurrent priority queue with relaxed ordering.
+ *
+ * A MultiQueue spreads its values over several heaps, each behind its
+ * own lock. Inserts go to a random heap, and extracts lock two random
+ * heaps and take the better of their tops. Threads rarely wait
+ * for each other as long as there are a few heaps per thread, at the
+ * cost of extracts returning a value close to, but not always exactly,
+ * the best one.
+ * @file
+ */
+#ifndef __MULTIQUEUE_H__
+#define __MULTIQUEUE_H__
+
+#include <stdbool.h>
+#include "heap.h"
+
+/**
+ * MultiQueue type.
+ */
+typedef struct multiqueue multiqueue_t;
+
+/**
+ * Create a MultiQueue.
+ * @param queues number of heaps, 0 for twice the number of processors
+ * @param cmp function comparing two values
+ * @param max extract the largest values first instead of the smallest
+ * @return new queue, NULL on failure
+ */
+multiqueue_t *multiqueue_new(int queues, heap_compare_func cmp, bool max);
+
+/**
+ * Get the number of heaps.
+ * @param queue queue to check
+ * @return number of heaps
+ */
+int multiqueue_queues(multiqueue_t *queue);
+
+/**
+ * Get the number of values in the queue. It may be out of date by the
+ * time it returns if other threads are using the queue.
+ * @param queue queue to check
+ * @return number of values
+ */
+long multiqueue_size(multiqueue_t *queue);
+
+/**
+ * Insert a value. Safe to call from several threads.
+ * @param queue queue to insert into
+ * @param value value to insert
+ * @return false if the heap could not grow
+ */
+bool multiqueue_insert(multiqueue_t *queue, void *value);
+
+/**
+ * Extract one of the best values. Safe to call from several threads.
+ * With a single heap the best value is always returned. Values are only
+ * passed to the compare function while they are in the queue.
+ * @param queue queue to extract from
+ * @return the value, NULL if the queue is empty
+ */
+void *multiqueue_extract(multiqueue_t *queue);
+
+/**
+ * Free the queue. The values are not freed.
+ * @param queue queue to free
+ */
+void multiqueue_free(multiqueue_t *queue);
+
+#endif //__MULTIQUEUE_H__
@@ -0,0 +1,109 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "reader.h"
+#include "huffman.h"
+#include "memory.h"
+
+struct reader {
+    bit_array_t *tree_bits;
+    bit_array_t *bits;
+    huffman_node_t *root;
+    huffman_sync_t *sync;
+};
+
+reader_t *reader_open(const char *path)
+{
+    struct stat st;
+    uint8_t header[HUFFMAN_HEADER_SIZE];
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    ssize_t header_size = pread(fd, header, sizeof(header), 0);
+
+    if (fstat(fd, &st) < 0 || header_size < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // legacy files have no header and 32-bit lengths
+    uint32_t version = huffman_header_version(header, header_size);
+    bit_array_t *(*map)(int, off_t *, bool) = bit_array_map;
+    off_t offset = HUFFMAN_HEADER_SIZE;
+
+    if (version == HUFFMAN_VERSION_LEGACY) {
+        map = bit_array_map_legacy;
+        offset = 0;
+    } else if (version != HUFFMAN_VERSION) {
+        close(fd);
+        return NULL;
+    }
+
+    reader_t *reader = memory_calloc(MEMORY_READER, 1, sizeof(reader_t));
+
+    if (reader == NULL) {
+        close(fd);
+        return NULL;
+    }
+
+    reader->tree_bits = map(fd, &offset, false);
+
+    if (reader->tree_bits != NULL) {
+        reader->bits = map(fd, &offset, false);
+    }
+
+    if (reader->bits == NULL || bit_array_length(reader->tree_bits) == 0) {
+        close(fd);
+        reader_close(reader);
+        return NULL;
+    }
+
+    reader->root = huffman_build_tree(reader->tree_bits);
+
+    // sync points are optional and follow the message
+    if (reader->root != NULL && offset < st.st_size) {
+        bit_array_t *sync_bits = map(fd, &offset, false);
+
+        if (sync_bits != NULL) {
+            reader->sync = huffman_sync_decode(sync_bits);
+            bit_array_free(sync_bits);
+        }
+    }
+
+    close(fd);
+
+    if (reader->root == NULL) {
+        reader_close(reader);
+        return NULL;
+    }
+
+    return reader;
+}
+
+size_t reader_read(reader_t *reader, size_t offset, size_t length, char *buf)
+{
+    return huffman_decode_range(reader->root, reader->bits, reader->sync, offset, length, buf);
+}
+
+void reader_close(reader_t *reader)
+{
+    huffman_sync_free(reader->sync);
+
+    if (reader->root != NULL) {
+        huffman_free(reader->root, NULL);
+    }
+
+    if (reader->bits != NULL) {
+        bit_array_free(reader->bits);
+    }
+
+    if (reader->tree_bits != NULL) {
+        bit_array_free(reader->tree_bits);
+    }
+
+    memory_free(MEMORY_READER, reader);
+}
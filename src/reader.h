@@ -0,0 +1,44 @@
+/**
+ * Random-access reader for compressed files.
+ *
+ * The arrays of the compressed file are memory-mapped with
+ * bit_array_map(), so opening a file does not copy the payload into the
+ * heap. Files in the legacy layout without a header are read as well. Reads decode
+ * only as much of the stream as is needed to cover the requested range,
+ * starting from the closest sync point when the file has them.
+ * @file
+ */
+#ifndef __READER_H__
+#define __READER_H__
+
+#include <stddef.h>
+
+/**
+ * Reader type.
+ */
+typedef struct reader reader_t;
+
+/**
+ * Open a file written by the encoder.
+ * @param path path of the compressed file
+ * @return the new reader, NULL if the file could not be mapped or is corrupt
+ */
+reader_t *reader_open(const char *path);
+
+/**
+ * Decode a byte range of the original data.
+ * @param reader reader to decode from
+ * @param offset offset in the original data
+ * @param length number of bytes to decode
+ * @param buf destination buffer of at least length bytes
+ * @return number of bytes decoded, less than length at the end of the data
+ */
+size_t reader_read(reader_t *reader, size_t offset, size_t length, char *buf);
+
+/**
+ * Unmap the file and free memory allocated by the reader.
+ * @param reader reader to close
+ */
+void reader_close(reader_t *reader);
+
+#endif //__READER_H__
@@ -1,27 +1,82 @@
 #include <assert.h>
 #include <stdlib.h>
 #include "stack.h"
-#include "list.h"
+#include "memory.h"
 
+#define STACK_MIN_CAPACITY 16
+
+/*
+ * Values are stored at slots 1 to length, with NULL in slot 0 and slot
+ * length + 1. The iterators walk the slots and stop at those sentinels.
+ */
 struct stack {
-    list_t *list;
+    stack_compare_func cmp;
+    stack_free_func free_value;
+    void **slots;
+    int length;
+    int capacity;   /**< values that fit without growing */
+    bool shrink;
 };
 
+/**
+ * Resize the storage to hold capacity values.
+ * @return false if the memory could not be allocated
+ */
+bool stack_resize(stack2_t *stack, int capacity)
+{
+    void **slots = memory_realloc(MEMORY_STACK, stack->slots, (capacity + 2) * sizeof(void*));
+
+    if (slots == NULL) {
+        return false;
+    }
+
+    slots[0] = NULL;
+    slots[stack->length + 1] = NULL;
+    stack->slots = slots;
+    stack->capacity = capacity;
+
+    return true;
+}
+
 stack2_t *stack_new(stack_compare_func cmp, stack_free_func free_value)
 {
-    stack2_t *stack = calloc(1, sizeof(stack2_t));
+    stack2_t *stack = memory_calloc(MEMORY_STACK, 1, sizeof(stack2_t));
 
     if (stack != NULL) {
-        stack->list = list_new(cmp, free_value);
+        stack->cmp = cmp;
+        stack->free_value = free_value;
+
+        if (!stack_resize(stack, STACK_MIN_CAPACITY)) {
+            memory_free(MEMORY_STACK, stack);
+            return NULL;
+        }
     }
 
     return stack;
 }
 
+bool stack_reserve(stack2_t *stack, int capacity)
+{
+    assert(stack != NULL);
+    return capacity <= stack->capacity || stack_resize(stack, capacity);
+}
+
+void stack_set_shrink(stack2_t *stack, bool shrink)
+{
+    assert(stack != NULL);
+    stack->shrink = shrink;
+}
+
 void stack_push(stack2_t *stack, void *value)
 {
     assert(stack != NULL);
-    list_append(stack->list, value);
+
+    if (stack->length == stack->capacity && !stack_resize(stack, 2 * stack->capacity)) {
+        return;
+    }
+
+    stack->slots[++stack->length] = value;
+    stack->slots[stack->length + 1] = NULL;
 }
 
 void *stack_pop(stack2_t *stack)
@@ -32,8 +87,15 @@ void *stack_pop(stack2_t *stack)
         return NULL;
     }
 
-    void *data;
-    list_remove(stack->list, -1, &data);
+    void *data = stack->slots[stack->length];
+    stack->slots[stack->length--] = NULL;
+
+    // halve only at a quarter full, so pushes and pops around a boundary don't resize
+    if (stack->shrink && stack->capacity > STACK_MIN_CAPACITY &&
+        stack->length < stack->capacity / 4) {
+        stack_resize(stack, stack->capacity / 2);
+    }
+
     return data;
 }
 
@@ -45,25 +107,64 @@ void *stack_peek(stack2_t *stack)
         return NULL;
     }
 
-    return list_last(stack->list);
+    return stack->slots[stack->length];
 }
 
 int stack_length(stack2_t *stack)
 {
     assert(stack != NULL);
-    return list_length(stack->list);
+    return stack->length;
 }
 
 void stack_clear(stack2_t *stack)
 {
-    list_clear(stack->list);
+    if (stack->free_value != NULL) {
+        for (int i = 1; i <= stack->length; i++) {
+            stack->free_value(stack->slots[i]);
+        }
+    }
+
+    stack->length = 0;
+    stack->slots[1] = NULL;
+
+    if (stack->shrink && stack->capacity > STACK_MIN_CAPACITY) {
+        stack_resize(stack, STACK_MIN_CAPACITY);
+    }
 }
 
 void stack_free(stack2_t *stack)
 {
     assert(stack != NULL);
-    list_free(stack->list);
-    free(stack);
+    stack_clear(stack);
+    memory_free(MEMORY_STACK, stack->slots);
+    memory_free(MEMORY_STACK, stack);
+}
+
+/**
+ * Get the value in a slot.
+ * @see iter_value_fun
+ */
+void *stack_value(void *slot)
+{
+    return (slot == NULL) ? NULL : *(void **) slot;
+}
+
+/**
+ * Get the slot above.
+ * @see iter_next_fun
+ */
+void *stack_next(void *slot)
+{
+    return (void **) slot + 1;
+}
+
+/**
+ * Get the slot below.
+ * @see iter_next_fun
+ */
+void *stack_prev(void *slot)
+{
+    return (void **) slot - 1;
 }
 
 iter_t *iter_stack(stack2_t *stack)
@@ -72,7 +173,7 @@ iter_t *iter_stack(stack2_t *stack)
         return NULL;
     }
 
-    return iter_list(stack->list);
+    return iter_new(&stack->slots[1], stack_value, stack_next);
 }
 
 iter_t *iter_stack_reverse(stack2_t *stack)
@@ -81,5 +182,5 @@ iter_t *iter_stack_reverse(stack2_t *stack)
         return NULL;
     }
 
-    return iter_list_reverse(stack->list);
+    return iter_new(&stack->slots[stack->length], stack_value, stack_prev);
 }
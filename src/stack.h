@@ -1,7 +1,9 @@
 /**
  * Generic stack.
  *
- * Currently just a convenient abstraction layer on top of {@link list.h}.
+ * The values are kept in an array that doubles when it is full, so pushes
+ * and pops don't allocate. Optionally the array is halved again once it
+ * drops to a quarter full.
  * @file
  */
 #ifndef __STACK_H__
@@ -28,15 +30,31 @@ typedef void(*stack_free_func)(void *);
 /**
  * Create a new stack.
  * @param cmp compare values function pointer
- * @param free_value free value function pointer
+ * @param free_value free value function pointer, NULL to leave values alone
  * @return the new stack
  */
 stack2_t *stack_new(stack_compare_func cmp, stack_free_func free_value);
 
+/**
+ * Make room for a number of values up front.
+ * @param stack stack to grow
+ * @param capacity number of values to make room for
+ * @return false if the memory could not be allocated
+ */
+bool stack_reserve(stack2_t *stack, int capacity);
+
+/**
+ * Choose whether the stack gives memory back as it empties. It is off by
+ * default, which suits stacks that are filled and emptied repeatedly.
+ * @param stack stack to configure
+ * @param shrink halve the storage when it is a quarter full
+ */
+void stack_set_shrink(stack2_t *stack, bool shrink);
+
 /**
  * Push value on top of the stack.
  * @param stack stack to push to
- * @param value value that will be placed on the top of the stack<Plug>(neosnippet_expand)
+ * @param value value that will be placed on the top of the stack
  */
 void stack_push(stack2_t *stack, void *value);
 
@@ -61,6 +79,10 @@ void *stack_peek(stack2_t *stack);
  */
 int stack_length(stack2_t *stack);
 
+/**
+ * Remove all values from the stack, freeing them.
+ * @param stack stack to clear
+ */
 void stack_clear(stack2_t *stack);
 
 /**
@@ -71,7 +93,8 @@ void stack_clear(stack2_t *stack);
 void stack_free(stack2_t *stack);
 
 /**
- * Helper function to create a new stack iterator.
+ * Helper function to create a new stack iterator, going from the bottom
+ * of the stack to the top. Pushing or popping invalidates the iterators.
  * @param stack stack to iterate over
  * @see iter_new()
  * @return Iterator
@@ -79,7 +102,8 @@ void stack_free(stack2_t *stack);
 iter_t *iter_stack(stack2_t *stack);
 
 /**
- * Helper function to create a new reverse stack iterator.
+ * Helper function to create a new reverse stack iterator, going from the
+ * top of the stack to the bottom.
  * @param stack stack to iterate over
  * @see iter_new()
  * @return Iterator
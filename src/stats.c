@@ -0,0 +1,119 @@
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include "stats.h"
+
+static const char *stage_names[STATS_NUM_STAGES] = {
+    "read", "histogram", "tree", "table", "encode", "decode", "write"
+};
+
+double stats_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void stats_init(stats_t *stats, stats_callback_func callback, void *data)
+{
+    memset(stats, 0, sizeof(stats_t));
+    stats->callback = callback;
+    stats->callback_data = data;
+}
+
+void stats_begin(stats_t *stats)
+{
+    stats->started = stats_now();
+}
+
+void stats_end(stats_t *stats, stats_stage_t stage)
+{
+    struct rusage usage;
+
+    stats->stage_ns[stage] += stats_now() - stats->started;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        stats->peak_memory = (size_t) usage.ru_maxrss * 1024;
+    }
+
+    if (stats->callback != NULL) {
+        stats->callback(stats, stage, stats->callback_data);
+    }
+}
+
+const char *stats_stage_name(stats_stage_t stage)
+{
+    return stage_names[stage];
+}
+
+double stats_entropy(uint64_t freq[256])
+{
+    double total = 0;
+    double entropy = 0;
+
+    for (int i = 0; i < 256; i++) {
+        total += freq[i];
+    }
+
+    for (int i = 0; i < 256; i++) {
+        if (freq[i] > 0) {
+            double p = freq[i] / total;
+            entropy -= p * log2(p);
+        }
+    }
+
+    return entropy;
+}
+
+void stats_print(stats_t *stats, FILE *file, bool json)
+{
+    double total_ns = 0;
+    double code_length = (stats->symbols > 0) ? stats->encoded_bits / (double) stats->symbols : 0;
+
+    for (int i = 0; i < STATS_NUM_STAGES; i++) {
+        total_ns += stats->stage_ns[i];
+    }
+
+    if (json) {
+        fprintf(file, "{\"stages_ms\": {");
+        for (int i = 0; i < STATS_NUM_STAGES; i++) {
+            fprintf(file, "%s\"%s\": %.3f", (i > 0) ? ", " : "", stage_names[i],
+                    stats->stage_ns[i] / 1e6);
+        }
+        fprintf(file, "}, \"total_ms\": %.3f, \"bytes_in\": %" PRIu64 ", "
+                "\"bytes_out\": %" PRIu64 ", \"blocks\": %" PRIu64 ", \"symbols\": %" PRIu64 ", "
+                "\"average_code_length\": %.4f, \"entropy\": %.4f, "
+                "\"table_rebuilds\": %" PRIu64 ", \"peak_memory\": %zu",
+                total_ns / 1e6, stats->bytes_in, stats->bytes_out, stats->blocks,
+                stats->symbols, code_length, stats->entropy, stats->table_rebuilds,
+                stats->peak_memory);
+        if (stats->memory != NULL) {
+            fprintf(file, ", \"memory\": ");
+            memory_accounting_print(stats->memory, file, true);
+        }
+        fprintf(file, "}\n");
+        return;
+    }
+
+    fprintf(file, "Stage        Time (ms)   MB/s\n");
+    for (int i = 0; i < STATS_NUM_STAGES; i++) {
+        if (stats->stage_ns[i] > 0) {
+            fprintf(file, "%-10s %11.3f %8.1f\n", stage_names[i], stats->stage_ns[i] / 1e6,
+                    stats->symbols / (stats->stage_ns[i] / 1e9) / 1e6);
+        }
+    }
+    fprintf(file, "%-10s %11.3f\n", "total", total_ns / 1e6);
+    fprintf(file, "Bytes in:            %" PRIu64 "\n", stats->bytes_in);
+    fprintf(file, "Bytes out:           %" PRIu64 "\n", stats->bytes_out);
+    fprintf(file, "Blocks:              %" PRIu64 "\n", stats->blocks);
+    fprintf(file, "Symbols:             %" PRIu64 "\n", stats->symbols);
+    fprintf(file, "Average code length: %.4f bits\n", code_length);
+    if (stats->entropy > 0)
+        fprintf(file, "Entropy:             %.4f bits\n", stats->entropy);
+    fprintf(file, "Table rebuilds:      %" PRIu64 "\n", stats->table_rebuilds);
+    fprintf(file, "Peak memory:         %zu KiB\n", stats->peak_memory / 1024);
+    if (stats->memory != NULL)
+        memory_accounting_print(stats->memory, file, false);
+}
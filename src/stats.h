@@ -0,0 +1,100 @@
+/**
+ * Runtime statistics of a compression or decompression run.
+ *
+ * Callers time each stage with stats_begin() and stats_end() and fill in
+ * the counters; an optional callback sees the statistics after every
+ * stage so they can be exported while a long run is still going.
+ * @file
+ */
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "memory.h"
+
+/**
+ * Pipeline stages.
+ */
+typedef enum stats_stage {
+    STATS_READ,
+    STATS_HISTOGRAM,
+    STATS_TREE,
+    STATS_TABLE,
+    STATS_ENCODE,
+    STATS_DECODE,
+    STATS_WRITE,
+    STATS_NUM_STAGES
+} stats_stage_t;
+
+typedef struct stats stats_t;
+
+/**
+ * Function pointer called when a stage ends.
+ */
+typedef void(*stats_callback_func)(stats_t *stats, stats_stage_t stage, void *data);
+
+/**
+ * Statistics of one run.
+ */
+struct stats {
+    double stage_ns[STATS_NUM_STAGES];  /**< wall time spent in each stage */
+    uint64_t bytes_in;                  /**< bytes read */
+    uint64_t bytes_out;                 /**< bytes written */
+    uint64_t blocks;                    /**< chunks the data was processed in */
+    uint64_t symbols;                   /**< symbols encoded or decoded */
+    uint64_t encoded_bits;              /**< length of the encoded message */
+    double entropy;                     /**< bits per symbol, 0 if unknown */
+    uint64_t table_rebuilds;            /**< number of code tables built */
+    size_t peak_memory;                 /**< peak resident set size in bytes */
+    memory_accounting_t *memory;        /**< allocations per subsystem, or NULL */
+    stats_callback_func callback;
+    void *callback_data;
+    double started;
+};
+
+/**
+ * Reset statistics.
+ * @param stats statistics to reset
+ * @param callback function called after each stage, or NULL
+ * @param data user pointer passed to callback
+ */
+void stats_init(stats_t *stats, stats_callback_func callback, void *data);
+
+/**
+ * Start timing a stage.
+ * @param stats statistics to update
+ */
+void stats_begin(stats_t *stats);
+
+/**
+ * Stop timing a stage and add the elapsed time to it.
+ * @param stats statistics to update
+ * @param stage stage that ended
+ */
+void stats_end(stats_t *stats, stats_stage_t stage);
+
+/**
+ * Get the name of a stage.
+ * @param stage stage
+ * @return lower case name of the stage
+ */
+const char *stats_stage_name(stats_stage_t stage);
+
+/**
+ * Compute the entropy of a byte histogram.
+ * @param freq occurrences of each byte value
+ * @return entropy in bits per symbol
+ */
+double stats_entropy(uint64_t freq[256]);
+
+/**
+ * Print statistics.
+ * @param stats statistics to print
+ * @param file file to print to
+ * @param json print JSON instead of human-readable text
+ */
+void stats_print(stats_t *stats, FILE *file, bool json);
+
+#endif //__STATS_H__
@@ -0,0 +1,211 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "memory.h"
+#include "trace.h"
+
+#define TRACE_INITIAL_EVENTS 256
+
+typedef struct trace_event {
+    const char *name;
+    char phase;             /**< 'B' while open, 'X' once ended, 'E' if unmatched */
+    long block;
+    long ns;
+    long duration;
+    long parent;            /**< index of the enclosing open span, or -1 */
+} trace_event_t;
+
+typedef struct trace_buffer {
+    long tid;
+    long open;              /**< index of the innermost open span, or -1 */
+    size_t count;
+    size_t capacity;
+    trace_event_t *events;
+    struct trace_buffer *next;
+} trace_buffer_t;
+
+static atomic_bool enabled;
+static atomic_uint generation;
+static _Atomic(trace_buffer_t *) buffers;
+static char *trace_path;
+static long epoch;
+static bool registered;
+
+// buffer of the calling thread, owned by that thread until trace_stop()
+static __thread trace_buffer_t *local;
+static __thread unsigned int local_generation;
+
+long trace_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void trace_exit()
+{
+    if (trace_enabled())
+        trace_stop();
+}
+
+bool trace_start(const char *path)
+{
+    if (trace_enabled())
+        return false;
+
+    trace_path = memory_strdup(MEMORY_TRACE, path);
+    if (trace_path == NULL)
+        return false;
+
+    if (!registered) {
+        atexit(trace_exit);
+        registered = true;
+    }
+
+    epoch = trace_now();
+    atomic_fetch_add(&generation, 1);
+    atomic_store(&enabled, true);
+
+    return true;
+}
+
+bool trace_enabled()
+{
+    return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+trace_buffer_t *trace_buffer()
+{
+    unsigned int current = atomic_load(&generation);
+
+    // buffers left over from an earlier trace have already been freed
+    if (local != NULL && local_generation == current)
+        return local;
+
+    local = memory_calloc(MEMORY_TRACE, 1, sizeof(trace_buffer_t));
+    if (local == NULL)
+        return NULL;
+
+    local->tid = syscall(SYS_gettid);
+    local->open = -1;
+    local_generation = current;
+
+    // publish the buffer with a lock-free push onto the list
+    local->next = atomic_load(&buffers);
+    while (!atomic_compare_exchange_weak(&buffers, &local->next, local))
+        ;
+
+    return local;
+}
+
+void trace_record(const char *name, char phase, long block)
+{
+    long ns = trace_now();
+    trace_buffer_t *buffer = trace_buffer();
+
+    if (buffer == NULL)
+        return;
+
+    // close the matching span into a complete event so the file carries its duration
+    if (phase == 'E' && buffer->open >= 0) {
+        trace_event_t *begin = &buffer->events[buffer->open];
+
+        if (strcmp(begin->name, name) == 0 && begin->block == block) {
+            begin->phase = 'X';
+            begin->duration = ns - epoch - begin->ns;
+            buffer->open = begin->parent;
+            return;
+        }
+    }
+
+    if (buffer->count == buffer->capacity) {
+        size_t capacity = buffer->capacity ? 2 * buffer->capacity : TRACE_INITIAL_EVENTS;
+        trace_event_t *events = memory_realloc(MEMORY_TRACE, buffer->events,
+                                               capacity * sizeof(trace_event_t));
+
+        if (events == NULL)
+            return;
+
+        buffer->events = events;
+        buffer->capacity = capacity;
+    }
+
+    buffer->events[buffer->count] = (trace_event_t) {
+        .name = name, .phase = phase, .block = block, .ns = ns - epoch, .parent = buffer->open
+    };
+
+    if (phase == 'B')
+        buffer->open = buffer->count;
+    buffer->count++;
+}
+
+void trace_begin(const char *name, long block)
+{
+    if (trace_enabled())
+        trace_record(name, 'B', block);
+}
+
+void trace_end(const char *name, long block)
+{
+    if (trace_enabled())
+        trace_record(name, 'E', block);
+}
+
+bool trace_stop()
+{
+    if (!trace_enabled())
+        return false;
+
+    atomic_store(&enabled, false);
+
+    trace_buffer_t *buffer = atomic_exchange(&buffers, NULL);
+    FILE *file = fopen(trace_path, "w");
+    bool first = true;
+    long pid = getpid();
+
+    if (file != NULL)
+        fprintf(file, "{\"traceEvents\": [\n");
+
+    while (buffer != NULL) {
+        trace_buffer_t *next = buffer->next;
+
+        for (size_t i = 0; file != NULL && i < buffer->count; i++) {
+            trace_event_t *event = &buffer->events[i];
+
+            fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %ld.%03ld",
+                    first ? "" : ",\n", event->name, event->phase,
+                    event->ns / 1000, event->ns % 1000);
+
+            if (event->phase == 'X')
+                fprintf(file, ", \"dur\": %ld.%03ld", event->duration / 1000,
+                        event->duration % 1000);
+
+            fprintf(file, ", \"pid\": %ld, \"tid\": %ld", pid, buffer->tid);
+
+            if (event->block >= 0)
+                fprintf(file, ", \"args\": {\"block\": %ld}", event->block);
+
+            fprintf(file, "}");
+            first = false;
+        }
+
+        memory_free(MEMORY_TRACE, buffer->events);
+        memory_free(MEMORY_TRACE, buffer);
+        buffer = next;
+    }
+
+    bool written = false;
+    if (file != NULL) {
+        fprintf(file, "\n], \"displayTimeUnit\": \"ns\"}\n");
+        written = (fclose(file) == 0);
+    }
+
+    memory_free(MEMORY_TRACE, trace_path);
+    trace_path = NULL;
+
+    return written;
+}
@@ -0,0 +1,52 @@
+/**
+ * Timeline tracer in the Chrome trace-event format.
+ *
+ * Every thread records spans into its own buffer without taking any
+ * locks; trace_stop() writes all buffers as a JSON file that
+ * chrome://tracing and Perfetto can open. Ended spans are written as
+ * complete events with a duration, spans still open as begin events.
+ * Tracing is off until trace_start() is called, and the event functions
+ * return immediately while it is off.
+ * @file
+ */
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdbool.h>
+
+/**
+ * Start recording events. The trace is written to path by trace_stop(),
+ * which is also registered to run at exit.
+ * @param path file to write the trace to
+ * @return false if tracing could not be started
+ */
+bool trace_start(const char *path);
+
+/**
+ * Check if events are being recorded.
+ * @return true between trace_start() and trace_stop()
+ */
+bool trace_enabled();
+
+/**
+ * Record the beginning of a span on the calling thread.
+ * @param name name of the span, must stay valid until trace_stop()
+ * @param block block number shown with the span, negative for none
+ */
+void trace_begin(const char *name, long block);
+
+/**
+ * Record the end of the span most recently begun on the calling thread.
+ * @param name name of the span, must match trace_begin()
+ * @param block block number shown with the span, negative for none
+ */
+void trace_end(const char *name, long block);
+
+/**
+ * Stop recording, write the trace file and free all buffers.
+ * Threads that recorded events must have finished.
+ * @return false if the trace file could not be written
+ */
+bool trace_stop();
+
+#endif //__TRACE_H__
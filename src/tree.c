@@ -6,6 +6,7 @@
 #include <string.h>
 #include <stdio.h>
 #include "tree.h"
+#include "memory.h"
 #include "stack.h"
 
 typedef struct node node_t;
@@ -32,7 +33,7 @@ struct node {
 
 node_t *node_new(node_t *parent)
 {
-    node_t *node = calloc(1, sizeof(node_t));
+    node_t *node = memory_calloc(MEMORY_TREE, 1, sizeof(node_t));
 
     if (node != NULL) {
         node->parent = parent;
@@ -43,7 +44,7 @@ node_t *node_new(node_t *parent)
 
 tree_t *tree_new(tree_compare_func cmp, tree_free_func free_key)
 {
-    tree_t *tree = calloc(1, sizeof(tree_t));
+    tree_t *tree = memory_calloc(MEMORY_TREE, 1, sizeof(tree_t));
 
     if (tree != NULL) {
         tree->root = node_new(NULL);
@@ -167,19 +168,49 @@ void *node_next(void *n)
     return node;
 }
 
-node_t *node_find(tree_t *tree, node_t *node, void *key)
+node_t *node_find(tree_t *tree, void *key)
 {
+    node_t *node = tree->root;
+
     while (node != NULL && node->key != NULL) {
-        if (tree->cmp(node->key, key) == 0) {
+        int cmp = tree->cmp(key, node->key);
+
+        if (cmp == 0) {
             return node;
         }
 
-        node = node_next(node);
+        node = (cmp < 0) ? node->left : node->right;
     }
 
     return NULL;
 }
 
+/**
+ * Find the node with the smallest key after the given key.
+ * @param tree tree to search
+ * @param key key to compare with
+ * @param inclusive also accept a node with an equal key
+ * @return the node, NULL if every key comes before
+ */
+node_t *node_bound(tree_t *tree, void *key, bool inclusive)
+{
+    node_t *node = tree->root;
+    node_t *bound = NULL;
+
+    while (node != NULL && node->key != NULL) {
+        int cmp = tree->cmp(key, node->key);
+
+        if (cmp < 0 || (cmp == 0 && inclusive)) {
+            bound = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+
+    return bound;
+}
+
 void node_replace(tree_t *tree, node_t *a, node_t *b)
 {
     if (a->parent == NULL) {
@@ -209,7 +240,7 @@ void node_free(node_t *node, tree_free_func free_key)
         free_key(key);
     }
 
-    free(node);
+    memory_free(MEMORY_TREE, node);
 }
 
 bool tree_remove(tree_t *tree, void *key)
@@ -218,8 +249,7 @@ bool tree_remove(tree_t *tree, void *key)
         return false;
     }
 
-    node_t *min = node_minimum(tree->root);
-    node_t *node = node_find(tree, min, key);
+    node_t *node = node_find(tree, key);
 
     if (node == NULL) {
         return false;
@@ -243,13 +273,13 @@ bool tree_remove(tree_t *tree, void *key)
         min->left->parent = min;
     }
 
-    free(node);
+    memory_free(MEMORY_TREE, node);
     return true;
 }
 
 void *tree_find(tree_t *tree, void *key)
 {
-    node_t *node = node_find(tree, tree_start(tree), key);
+    node_t *node = node_find(tree, key);
 
     if (node == NULL) {
         return NULL;
@@ -260,7 +290,19 @@ void *tree_find(tree_t *tree, void *key)
 
 bool tree_has_key(tree_t *tree, void *key)
 {
-    return node_find(tree, tree_start(tree), key) != NULL;
+    return node_find(tree, key) != NULL;
+}
+
+void *tree_lower_bound(tree_t *tree, void *key)
+{
+    node_t *node = node_bound(tree, key, true);
+    return (node == NULL) ? NULL : node->key;
+}
+
+void *tree_upper_bound(tree_t *tree, void *key)
+{
+    node_t *node = node_bound(tree, key, false);
+    return (node == NULL) ? NULL : node->key;
 }
 
 void node_print(node_t *node, tree_print_func print, char *prefix, bool is_tail)
@@ -325,7 +367,7 @@ void tree_sort(tree_t *tree, int size)
         return;
     }
 
-    void **keys = calloc(length, size);
+    void **keys = memory_calloc(MEMORY_TREE, length, size);
 
     if (keys == NULL) {
         return;
@@ -333,7 +375,7 @@ void tree_sort(tree_t *tree, int size)
 
     _tree_dump(tree, keys, length);
     _tree_load(tree, keys, 0, length - 1);
-    free(keys);
+    memory_free(MEMORY_TREE, keys);
 }
 
 /**
@@ -358,6 +400,15 @@ iter_t *iter_tree(tree_t *tree)
     return iter_new(tree_start(tree), node_key, node_next);
 }
 
+iter_t *iter_tree_from(tree_t *tree, void *key)
+{
+    if (tree == NULL) {
+        return NULL;
+    }
+
+    return iter_new(node_bound(tree, key, true), node_key, node_next);
+}
+
 void *node_key_pre(void *t)
 {
     tree_t *tree = t;
@@ -402,5 +453,5 @@ void tree_free(tree_t *tree)
 {
     node_free(tree->root, tree->free_key);
     stack_free(tree->pre_stack);
-    free(tree);
+    memory_free(MEMORY_TREE, tree);
 }
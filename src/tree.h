@@ -84,6 +84,22 @@ void *tree_find(tree_t *tree, void *key);
  */
 bool tree_has_key(tree_t *tree, void *key);
 
+/**
+ * Find the smallest key that is not less than the given key.
+ * @param tree tree to search
+ * @param key key to compare with
+ * @return the node key, NULL if every key is less
+ */
+void *tree_lower_bound(tree_t *tree, void *key);
+
+/**
+ * Find the smallest key that is greater than the given key.
+ * @param tree tree to search
+ * @param key key to compare with
+ * @return the node key, NULL if no key is greater
+ */
+void *tree_upper_bound(tree_t *tree, void *key);
+
 /**
  * Print tree structure.
  * @param tree tree to print
@@ -106,6 +122,16 @@ void tree_sort(tree_t *tree, int size);
  */
 iter_t *iter_tree(tree_t *tree);
 
+/**
+ * Create a new in-order tree iterator that starts at the lower bound of a
+ * key, for walking a range of keys.
+ * @param tree tree to iterate over
+ * @param key key to start at
+ * @see tree_lower_bound()
+ * @return Iterator
+ */
+iter_t *iter_tree_from(tree_t *tree, void *key);
+
 /**
  * Create a new pre-order tree iterator.
  * Note: restart iterator does not work with this iterator.
@@ -0,0 +1,429 @@
+#include <stdint.h>
+#include <string.h>
+#include "ulist.h"
+#include "memory.h"
+
+#define CHUNK_SIZE 256
+#define CHUNK_VALUES 29
+#define CHUNK_MERGE (CHUNK_VALUES / 4)
+
+typedef struct chunk chunk_t;
+
+/*
+ * Chunks are aligned to their size, so the chunk holding a value slot is
+ * found by rounding the slot's address down. The iterators rely on this
+ * to step through the values with a single pointer.
+ */
+struct chunk {
+    chunk_t *prev;
+    chunk_t *next;
+    int count;
+    void *values[CHUNK_VALUES];
+};
+
+_Static_assert(sizeof(chunk_t) <= CHUNK_SIZE, "chunk does not fit its alignment");
+
+struct ulist {
+    ulist_compare_func cmp;
+    ulist_free_func free_value;
+    chunk_t *first;
+    chunk_t *last;
+    int length;
+};
+
+static inline chunk_t *chunk_of(void **slot)
+{
+    return (chunk_t *) ((uintptr_t) slot & ~(uintptr_t) (CHUNK_SIZE - 1));
+}
+
+ulist_t *ulist_new(ulist_compare_func cmp, ulist_free_func free_value)
+{
+    ulist_t *list = memory_calloc(MEMORY_LIST, 1, sizeof(ulist_t));
+
+    if (list != NULL) {
+        list->cmp = cmp;
+        list->free_value = free_value;
+    }
+
+    return list;
+}
+
+/**
+ * Allocate an empty chunk and link it in after another one.
+ * @param list list to add the chunk to
+ * @param after chunk to link it after, NULL to make it the first
+ * @return the chunk, NULL on failure
+ */
+chunk_t *chunk_new(ulist_t *list, chunk_t *after)
+{
+    chunk_t *chunk = memory_aligned_alloc(MEMORY_LIST, CHUNK_SIZE, CHUNK_SIZE);
+
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    chunk->count = 0;
+    chunk->prev = after;
+    chunk->next = (after != NULL) ? after->next : list->first;
+
+    if (chunk->prev != NULL) {
+        chunk->prev->next = chunk;
+    } else {
+        list->first = chunk;
+    }
+
+    if (chunk->next != NULL) {
+        chunk->next->prev = chunk;
+    } else {
+        list->last = chunk;
+    }
+
+    return chunk;
+}
+
+void chunk_free(ulist_t *list, chunk_t *chunk)
+{
+    if (chunk->prev != NULL) {
+        chunk->prev->next = chunk->next;
+    } else {
+        list->first = chunk->next;
+    }
+
+    if (chunk->next != NULL) {
+        chunk->next->prev = chunk->prev;
+    } else {
+        list->last = chunk->prev;
+    }
+
+    memory_free(MEMORY_LIST, chunk);
+}
+
+/**
+ * Find the chunk holding an index, walking from the closer end.
+ * @param list list to search
+ * @param index index of a value, must be in the list
+ * @param offset stores the index of the value inside the chunk
+ * @return the chunk
+ */
+chunk_t *ulist_find_chunk(ulist_t *list, int index, int *offset)
+{
+    chunk_t *chunk;
+
+    if (index < list->length / 2) {
+        chunk = list->first;
+        while (index >= chunk->count) {
+            index -= chunk->count;
+            chunk = chunk->next;
+        }
+    } else {
+        index = list->length - 1 - index;
+        chunk = list->last;
+        while (index >= chunk->count) {
+            index -= chunk->count;
+            chunk = chunk->prev;
+        }
+        index = chunk->count - 1 - index;
+    }
+
+    *offset = index;
+    return chunk;
+}
+
+/**
+ * Insert a value into a chunk, splitting the chunk if it is full.
+ * @param list list holding the chunk
+ * @param chunk chunk to insert into
+ * @param offset position inside the chunk, up to its count
+ * @param value value to insert
+ * @return false if a chunk could not be allocated
+ */
+bool chunk_insert(ulist_t *list, chunk_t *chunk, int offset, void *value)
+{
+    if (chunk->count == CHUNK_VALUES) {
+        chunk_t *next = chunk_new(list, chunk);
+
+        if (next == NULL) {
+            return false;
+        }
+
+        // move the upper half to the new chunk
+        int half = CHUNK_VALUES / 2;
+        memcpy(next->values, chunk->values + half, (CHUNK_VALUES - half) * sizeof(void*));
+        next->count = CHUNK_VALUES - half;
+        chunk->count = half;
+
+        if (offset > half) {
+            chunk = next;
+            offset -= half;
+        }
+    }
+
+    memmove(chunk->values + offset + 1, chunk->values + offset,
+            (chunk->count - offset) * sizeof(void*));
+    chunk->values[offset] = value;
+    chunk->count++;
+    list->length++;
+
+    return true;
+}
+
+/**
+ * Remove a value from a chunk, merging the chunk with the next one or
+ * freeing it when it runs low.
+ * @param list list holding the chunk
+ * @param chunk chunk to remove from
+ * @param offset position of the value inside the chunk
+ */
+void chunk_remove(ulist_t *list, chunk_t *chunk, int offset)
+{
+    memmove(chunk->values + offset, chunk->values + offset + 1,
+            (chunk->count - offset - 1) * sizeof(void*));
+    chunk->count--;
+    list->length--;
+
+    if (chunk->count == 0) {
+        chunk_free(list, chunk);
+    } else if (chunk->count < CHUNK_MERGE && chunk->next != NULL &&
+               chunk->count + chunk->next->count <= CHUNK_VALUES) {
+        chunk_t *next = chunk->next;
+        memcpy(chunk->values + chunk->count, next->values, next->count * sizeof(void*));
+        chunk->count += next->count;
+        chunk_free(list, next);
+    }
+}
+
+bool ulist_append(ulist_t *list, void *value)
+{
+    chunk_t *chunk = list->last;
+    bool fresh = chunk == NULL || chunk->count == CHUNK_VALUES;
+
+    // fill the last chunk up instead of splitting it, so appends stay dense
+    if (fresh && (chunk = chunk_new(list, list->last)) == NULL) {
+        return false;
+    }
+
+    if (!chunk_insert(list, chunk, chunk->count, value)) {
+        // an empty chunk would break ulist_first and ulist_last
+        if (fresh) {
+            chunk_free(list, chunk);
+        }
+        return false;
+    }
+
+    return true;
+}
+
+bool ulist_prepend(ulist_t *list, void *value)
+{
+    chunk_t *chunk = list->first;
+    bool fresh = chunk == NULL || chunk->count == CHUNK_VALUES;
+
+    if (fresh && (chunk = chunk_new(list, NULL)) == NULL) {
+        return false;
+    }
+
+    if (!chunk_insert(list, chunk, 0, value)) {
+        if (fresh) {
+            chunk_free(list, chunk);
+        }
+        return false;
+    }
+
+    return true;
+}
+
+bool ulist_insert(ulist_t *list, int index, void *value)
+{
+    if (index == -1 || index == list->length) {
+        return ulist_append(list, value);
+    } else if (index == 0) {
+        return ulist_prepend(list, value);
+    } else if (index > 0 && index < list->length) {
+        int offset;
+        chunk_t *chunk = ulist_find_chunk(list, index, &offset);
+        return chunk_insert(list, chunk, offset, value);
+    }
+
+    return false;
+}
+
+bool ulist_delete(ulist_t *list, void *value)
+{
+    for (chunk_t *chunk = list->first; chunk != NULL; chunk = chunk->next) {
+        for (int i = 0; i < chunk->count; i++) {
+            if (list->cmp(chunk->values[i], value) == 0) {
+                chunk_remove(list, chunk, i);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool ulist_remove(ulist_t *list, int index, void **value)
+{
+    if (index == -1) {
+        index = list->length - 1;
+    }
+
+    if (index < 0 || index >= list->length) {
+        return false;
+    }
+
+    int offset;
+    chunk_t *chunk = ulist_find_chunk(list, index, &offset);
+
+    if (value == NULL) {
+        list->free_value(chunk->values[offset]);
+    } else {
+        *value = chunk->values[offset];
+    }
+
+    chunk_remove(list, chunk, offset);
+    return true;
+}
+
+bool ulist_has_value(ulist_t *list, void *value)
+{
+    for (chunk_t *chunk = list->first; chunk != NULL; chunk = chunk->next) {
+        for (int i = 0; i < chunk->count; i++) {
+            if (list->cmp(chunk->values[i], value) == 0) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void ulist_clear(ulist_t *list)
+{
+    while (list->first != NULL) {
+        chunk_t *chunk = list->first;
+
+        for (int i = 0; i < chunk->count; i++) {
+            list->free_value(chunk->values[i]);
+        }
+
+        chunk_free(list, chunk);
+    }
+
+    list->length = 0;
+}
+
+void *ulist_get(ulist_t *list, int index)
+{
+    if (index == -1) {
+        return ulist_last(list);
+    }
+
+    if (index < 0 || index >= list->length) {
+        return NULL;
+    }
+
+    int offset;
+    chunk_t *chunk = ulist_find_chunk(list, index, &offset);
+    return chunk->values[offset];
+}
+
+void *ulist_first(ulist_t *list)
+{
+    if (list->first == NULL) {
+        return NULL;
+    }
+
+    return list->first->values[0];
+}
+
+void *ulist_last(ulist_t *list)
+{
+    if (list->last == NULL) {
+        return NULL;
+    }
+
+    return list->last->values[list->last->count - 1];
+}
+
+int ulist_length(ulist_t *list)
+{
+    return list->length;
+}
+
+/**
+ * Get the value in a slot.
+ * @see iter_value_fun
+ */
+void *ulist_value(void *slot)
+{
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    return *(void **) slot;
+}
+
+/**
+ * Get the next slot, which is in the next chunk after the last one.
+ * @see iter_next_fun
+ */
+void *ulist_next(void *slot)
+{
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    chunk_t *chunk = chunk_of(slot);
+
+    if ((void **) slot + 1 < chunk->values + chunk->count) {
+        return (void **) slot + 1;
+    }
+
+    return (chunk->next != NULL) ? chunk->next->values : NULL;
+}
+
+/**
+ * Get the previous slot.
+ * @see iter_next_fun
+ */
+void *ulist_prev(void *slot)
+{
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    chunk_t *chunk = chunk_of(slot);
+
+    if ((void **) slot > chunk->values) {
+        return (void **) slot - 1;
+    }
+
+    return (chunk->prev != NULL) ? chunk->prev->values + chunk->prev->count - 1 : NULL;
+}
+
+iter_t *iter_ulist(ulist_t *list)
+{
+    if (list == NULL) {
+        return NULL;
+    }
+
+    return iter_new((list->first != NULL) ? list->first->values : NULL, ulist_value, ulist_next);
+}
+
+iter_t *iter_ulist_reverse(ulist_t *list)
+{
+    if (list == NULL) {
+        return NULL;
+    }
+
+    return iter_new((list->last != NULL) ? list->last->values + list->last->count - 1 : NULL,
+                    ulist_value, ulist_prev);
+}
+
+void ulist_free(ulist_t *list)
+{
+    if (list != NULL) {
+        ulist_clear(list);
+        memory_free(MEMORY_LIST, list);
+    }
+}
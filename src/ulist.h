@@ -0,0 +1,150 @@
+/**
+ * Unrolled linked list that can store values of any type.
+ *
+ * It has the same API as {@link list.h}, but each node holds up to 29
+ * values in a 256-byte aligned chunk, so scans read whole cache lines of
+ * values and finding an index skips a chunk at a time. Nodes split when
+ * inserting into a full one and merge with their neighbour when they drop
+ * below a quarter full.
+ * @file
+ */
+#ifndef __ULIST_H__
+#define __ULIST_H__
+
+#include <stdbool.h>
+#include "iter.h"
+
+/**
+ * List type.
+ */
+typedef struct ulist ulist_t;
+
+/**
+ * Function pointer to compare list elements.
+ */
+typedef int(*ulist_compare_func)(void *, void *);
+
+/**
+ * Function pointer to free element values.
+ */
+typedef void(*ulist_free_func)(void *);
+
+/**
+ * Create a new linked list.
+ * @param cmp fpointer to compare list values
+ * @param free_value fpointer to free list values
+ * @return the new list.
+ */
+ulist_t *ulist_new(ulist_compare_func cmp, ulist_free_func free_value);
+
+/**
+ * Add value to the end of the list.
+ * @param list list to append to
+ * @param value value to append
+ * @return false if a chunk could not be allocated
+ */
+bool ulist_append(ulist_t *list, void *value);
+
+/**
+ * Insert value at the beginning of the list.
+ * @param list list to prepend to
+ * @param value value to prepend
+ * @return false if a chunk could not be allocated
+ */
+bool ulist_prepend(ulist_t *list, void *value);
+
+/**
+ * Insert value at the specified index.
+ * @param list list to prepend to
+ * @param index index to insert at
+ * @param value value to prepend
+ */
+bool ulist_insert(ulist_t *list, int index, void *value);
+
+/**
+ * Delete list element with the given value.
+ * Note that the value's memory is not freed.
+ * @param list list to delete from
+ * @param value value of element to delete
+ * @return true if list element was successfully deleted
+ */
+bool ulist_delete(ulist_t *list, void *value);
+
+/**
+ * Remove list element by index.
+ * Note that the value's memory is not freed.
+ * @param list list to remove from
+ * @param index index of element, -1 for end of list
+ * @param value stores the value of the removed element
+ * @return true if element was removed successfully
+ */
+bool ulist_remove(ulist_t *list, int index, void **value);
+
+/**
+ * Check if list has a specific value.
+ * @param list list to check
+ * @param value value to search for
+ * @return true if the value exists in the list
+ */
+bool ulist_has_value(ulist_t *list, void *value);
+
+/**
+ * Clear the list of all elements.
+ * Note that all values inside the list will be freed as well as the elements.
+ * @param list list to clear
+ */
+void ulist_clear(ulist_t *list);
+
+/**
+ * Get value at the given index.
+ * @param list list to search
+ * @param index element index
+ * @return value of the element, NULL if index doesn't exist
+ */
+void *ulist_get(ulist_t *list, int index);
+
+/**
+ * Get the first value of the list.
+ * @param list list to get value from
+ * @return value of the first element, NULL if list is empty
+ */
+void *ulist_first(ulist_t *list);
+
+/**
+ * Get the last value of the list.
+ * @param list list to get value from
+ * @return value of the last element, NULL if list is empty
+ */
+void *ulist_last(ulist_t *list);
+
+/**
+ * Get the length of the list.
+ * @param list list to get length of
+ * @return number of elements in list
+ */
+int ulist_length(ulist_t *list);
+
+/**
+ * Free memory allocated by the list.
+ * Note that ulist_free also frees memory of all values.
+ * @param list list to free
+ */
+void ulist_free(ulist_t *list);
+
+/**
+ * Helper function to create a new list iterator.
+ * @param list list to iterate over
+ * @see iter_new()
+ * @return Iterator
+ */
+iter_t *iter_ulist(ulist_t *list);
+
+/**
+ * Helper function to create a new reverse list iterator.
+ * @param list list to iterate over
+ * @see iter_new()
+ * @return Iterator
+ */
+iter_t *iter_ulist_reverse(ulist_t *list);
+
+#endif //__ULIST_H__
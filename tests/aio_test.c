@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "tests.h"
+#include "aio.h"
+
+#define CHUNK 4096
+#define CHUNKS 16
+
+int init_suite_aio()
+{
+    return 0;
+}
+
+int clean_suite_aio()
+{
+    return 0;
+}
+
+void test_aio_round_trip(aio_backend_t backend)
+{
+    aio_t *aio = aio_new(backend, 4);
+
+    // io_uring may be disabled in the test environment
+    if (aio == NULL) {
+        CU_ASSERT(backend == AIO_URING);
+        return;
+    }
+
+    FILE *file = tmpfile();
+    int fd = fileno(file);
+
+    uint8_t *out = malloc(CHUNK * CHUNKS);
+    uint8_t *in = calloc(CHUNK * CHUNKS, 1);
+
+    for (int i = 0; i < CHUNK * CHUNKS; i++) {
+        out[i] = i * 7 + i / 256;
+    }
+
+    void *data;
+    int completed = 0;
+
+    // submit chunks in reverse order to exercise positional writes
+    for (int i = CHUNKS - 1; i >= 0; i--) {
+        while (!aio_write(aio, fd, out + i * CHUNK, CHUNK, i * CHUNK, &out[i * CHUNK])) {
+            CU_ASSERT(aio_wait(aio, &data) == CHUNK);
+            completed++;
+        }
+    }
+
+    CU_ASSERT(aio_pending(aio) <= 4);
+
+    while (aio_pending(aio) > 0) {
+        CU_ASSERT(aio_wait(aio, &data) == CHUNK);
+        completed++;
+    }
+
+    CU_ASSERT(completed == CHUNKS);
+
+    for (int i = 0; i < CHUNKS; i++) {
+        while (!aio_read(aio, fd, in + i * CHUNK, CHUNK, i * CHUNK, NULL)) {
+            CU_ASSERT(aio_wait(aio, &data) == CHUNK);
+        }
+    }
+
+    while (aio_pending(aio) > 0) {
+        CU_ASSERT(aio_wait(aio, &data) == CHUNK);
+    }
+
+    CU_ASSERT(memcmp(in, out, CHUNK * CHUNKS) == 0);
+
+    // reads past the end of file are short
+    CU_ASSERT(aio_read(aio, fd, in, CHUNK, CHUNK * CHUNKS - 10, &data) == true);
+    CU_ASSERT(aio_wait(aio, &data) == 10);
+
+    aio_free(aio);
+    fclose(file);
+    free(in);
+    free(out);
+}
+
+void test_aio_uring()
+{
+    test_aio_round_trip(AIO_URING);
+}
+
+void test_aio_threads()
+{
+    aio_t *aio = aio_new(AIO_THREADS, 2);
+    CU_ASSERT_STRING_EQUAL(aio_backend_name(aio), "threads");
+    aio_free(aio);
+
+    test_aio_round_trip(AIO_THREADS);
+}
+
+test_t AIO_TESTS[] = {
+    { "io_uring round trip", test_aio_uring },
+    { "thread pool round trip", test_aio_threads },
+    { NULL }
+};
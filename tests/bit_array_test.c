@@ -0,0 +1,360 @@
+#include <endian.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests.h"
+#include "bit_array.h"
+
+int init_suite_bit_array()
+{
+    return 0;
+}
+
+int clean_suite_bit_array()
+{
+    return 0;
+}
+
+void test_bit_array_put_peek()
+{
+    bit_array_t *array = bit_array_new(300);
+    uint64_t pos = 3;
+
+    bit_array_append(array, &pos, 0x5, 3);
+    bit_array_append(array, &pos, 0xdeadbeefcafef00dULL, 64);
+    bit_array_append(array, &pos, 0x1ffffffffffffffULL, 57);
+    CU_ASSERT(pos == 3 + 3 + 64 + 57);
+
+    pos = 3;
+    CU_ASSERT(bit_array_get(array, &pos, 3) == 0x5);
+    CU_ASSERT(bit_array_get(array, &pos, 64) == 0xdeadbeefcafef00dULL);
+    CU_ASSERT(bit_array_get(array, &pos, 57) == 0x1ffffffffffffffULL);
+    CU_ASSERT(bit_array_peek(array, pos, 64) == 0);
+
+    // single bit accessors see the same layout
+    CU_ASSERT(bit_array_test(array, 3));
+    CU_ASSERT(!bit_array_test(array, 4));
+    CU_ASSERT(bit_array_test(array, 5));
+    CU_ASSERT(!bit_array_test(array, 2));
+
+    // overwriting keeps the neighbouring bits
+    bit_array_put(array, 10, 0, 20);
+    CU_ASSERT(bit_array_peek(array, 6, 4) == (0xdeadbeefcafef00dULL & 0xf));
+    CU_ASSERT(bit_array_peek(array, 10, 20) == 0);
+    CU_ASSERT(bit_array_peek(array, 30, 8) == ((0xdeadbeefcafef00dULL >> 24) & 0xff));
+
+    bit_array_free(array);
+}
+
+void test_bit_array_copy()
+{
+    bit_array_t *src = bit_array_new(500);
+    bit_array_t *dest = bit_array_new(500);
+
+    for (uint64_t i = 0; i < 500; i++) {
+        if ((i * 7) % 3 == 0 || i % 11 == 0)
+            bit_array_set(src, i);
+    }
+
+    bit_array_copy(dest, 13, src, 5, 400);
+    for (uint64_t i = 0; i < 400; i++) {
+        CU_ASSERT(bit_array_test(dest, 13 + i) == bit_array_test(src, 5 + i));
+    }
+    CU_ASSERT(!bit_array_test(dest, 12));
+    CU_ASSERT(!bit_array_test(dest, 413));
+
+    // overlapping copy within one array behaves like memmove
+    bit_array_copy(dest, 0, src, 0, 500);
+    bit_array_copy(dest, 70, dest, 3, 300);
+    for (uint64_t i = 0; i < 300; i++) {
+        CU_ASSERT(bit_array_test(dest, 70 + i) == bit_array_test(src, 3 + i));
+    }
+
+    bit_array_free(src);
+    bit_array_free(dest);
+}
+
+void test_bit_array_wrap_unaligned()
+{
+    uint8_t storage[12] = { 0 };
+    uint8_t *data = storage + 1;    // deliberately not word aligned
+    bit_array_t *array = bit_array_wrap(data, 80);
+
+    bit_array_put(array, 20, 0xabcdef0123ULL, 40);
+    bit_array_put(array, 70, 0x3ff, 10);
+    CU_ASSERT(bit_array_peek(array, 20, 40) == 0xabcdef0123ULL);
+    CU_ASSERT(bit_array_peek(array, 70, 10) == 0x3ff);
+    CU_ASSERT(storage[0] == 0);
+    CU_ASSERT(storage[11] == 0);
+    CU_ASSERT(data[8] == 0xc0);
+    CU_ASSERT(data[9] == 0xff);
+
+    bit_array_free(array);
+}
+
+void test_bit_array_grow()
+{
+    bit_array_t *array = bit_array_new(0);
+    uint64_t pos = 0;
+
+    for (uint64_t i = 0; i < 10000; i++) {
+        CU_ASSERT(bit_array_append(array, &pos, i, 13));
+    }
+    CU_ASSERT(bit_array_length(array) == 13 * 10000);
+
+    pos = 0;
+    for (uint64_t i = 0; i < 10000; i++) {
+        CU_ASSERT(bit_array_get(array, &pos, 13) == (i & 0x1fff));
+    }
+
+    // shrinking and growing again exposes zeros
+    CU_ASSERT(bit_array_resize(array, 20));
+    CU_ASSERT(bit_array_resize(array, 200));
+    CU_ASSERT(bit_array_peek(array, 20, 64) == 0);
+    CU_ASSERT(bit_array_peek(array, 13, 7) == 1);
+
+    bit_array_free(array);
+}
+
+void test_bit_array_large()
+{
+    // past 2^32 bits, storage is mapped lazily so only touched pages cost memory
+    uint64_t length = 5000000000ULL;
+    bit_array_t *array = bit_array_new(length);
+
+    if (array == NULL || bit_array_data(array) == NULL)
+        return;
+
+    CU_ASSERT(bit_array_length(array) == length);
+
+    bit_array_set(array, length - 1);
+    bit_array_put(array, 4294967290ULL, 0x7ff, 11);
+    CU_ASSERT(bit_array_test(array, length - 1));
+    CU_ASSERT(!bit_array_test(array, length - 1 - 4294967296ULL));
+    CU_ASSERT(bit_array_peek(array, 4294967290ULL, 11) == 0x7ff);
+
+    bit_array_free(array);
+}
+
+void test_bit_array_count_fill()
+{
+    // lengths around the word and vector sizes, with partial last bytes
+    uint64_t lengths[] = { 1, 7, 63, 64, 65, 255, 256, 257, 1000, 4099 };
+
+    for (int l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        bit_array_t *array = bit_array_new(lengths[l]);
+        uint64_t expected = 0;
+
+        for (uint64_t i = 0; i < lengths[l]; i++) {
+            if (i % 3 == 0 || i % 7 == 0) {
+                bit_array_set(array, i);
+                expected++;
+            }
+        }
+        CU_ASSERT(bit_array_count(array) == expected);
+
+        bit_array_fill(array);
+        CU_ASSERT(bit_array_count(array) == lengths[l]);
+
+        bit_array_not(array);
+        CU_ASSERT(bit_array_count(array) == 0);
+
+        bit_array_free(array);
+    }
+}
+
+void test_bit_array_bitwise()
+{
+    bit_array_t *a = bit_array_new(203);
+    bit_array_t *b = bit_array_new(203);
+    bit_array_t *c = bit_array_new(203);
+    bit_array_t *other = bit_array_new(100);
+
+    for (uint64_t i = 0; i < 203; i++) {
+        if (i % 2 == 0)
+            bit_array_set(a, i);
+        if (i % 3 == 0)
+            bit_array_set(b, i);
+    }
+
+    CU_ASSERT(!bit_array_and(a, other));
+
+    bit_array_copy(c, 0, a, 0, 203);
+    CU_ASSERT(bit_array_and(c, b));
+    for (uint64_t i = 0; i < 203; i++) {
+        CU_ASSERT(bit_array_test(c, i) == (i % 6 == 0));
+    }
+
+    bit_array_copy(c, 0, a, 0, 203);
+    CU_ASSERT(bit_array_or(c, b));
+    for (uint64_t i = 0; i < 203; i++) {
+        CU_ASSERT(bit_array_test(c, i) == (i % 2 == 0 || i % 3 == 0));
+    }
+
+    bit_array_copy(c, 0, a, 0, 203);
+    CU_ASSERT(bit_array_xor(c, b));
+    for (uint64_t i = 0; i < 203; i++) {
+        CU_ASSERT(bit_array_test(c, i) == ((i % 2 == 0) != (i % 3 == 0)));
+    }
+
+    bit_array_copy(c, 0, b, 0, 203);
+    bit_array_shift_left(c, 70);
+    for (uint64_t i = 0; i < 203; i++) {
+        CU_ASSERT(bit_array_test(c, i) == (i >= 70 && (i - 70) % 3 == 0));
+    }
+
+    bit_array_copy(c, 0, b, 0, 203);
+    bit_array_shift_right(c, 5);
+    for (uint64_t i = 0; i < 203; i++) {
+        CU_ASSERT(bit_array_test(c, i) == (i < 198 && (i + 5) % 3 == 0));
+    }
+
+    bit_array_shift_right(c, 500);
+    CU_ASSERT(bit_array_count(c) == 0);
+
+    bit_array_free(a);
+    bit_array_free(b);
+    bit_array_free(c);
+    bit_array_free(other);
+}
+
+void test_bit_array_find_set()
+{
+    bit_array_t *array = bit_array_new(10000);
+    uint64_t expected[] = { 0, 5, 63, 64, 200, 4000, 4001, 9999 };
+    int num_expected = sizeof(expected) / sizeof(expected[0]);
+    uint64_t positions[3];
+    uint64_t pos;
+
+    for (int i = 0; i < num_expected; i++) {
+        bit_array_set(array, expected[i]);
+    }
+
+    CU_ASSERT(bit_array_find_set(array, 6, &pos) && pos == 63);
+    CU_ASSERT(bit_array_find_set(array, 201, &pos) && pos == 4000);
+    CU_ASSERT(!bit_array_find_set(array, 10000, &pos));
+
+    // batches continue where the previous one stopped
+    uint64_t from = 0;
+    int found = 0;
+    uint64_t count;
+    while ((count = bit_array_find_set_batch(array, &from, positions, 3)) > 0) {
+        for (uint64_t i = 0; i < count; i++) {
+            CU_ASSERT(positions[i] == expected[found++]);
+        }
+    }
+    CU_ASSERT(found == num_expected);
+
+    iter_t *it = iter_bit_array(array);
+    found = 0;
+    while (iter_has_next(it)) {
+        uint64_t *value = iter_next(it);
+        CU_ASSERT(*value == expected[found++]);
+    }
+    CU_ASSERT(found == num_expected);
+
+    // iterators rewind and don't share their position
+    iter_restart(it);
+    iter_t *other = iter_bit_array(array);
+    CU_ASSERT(*(uint64_t *) iter_next(it) == expected[0]);
+    CU_ASSERT(iter_length(it) == num_expected - 1);
+    CU_ASSERT(*(uint64_t *) iter_next(it) == expected[1]);
+    CU_ASSERT(*(uint64_t *) iter_next(other) == expected[0]);
+    iter_free(other);
+    iter_free(it);
+
+    bit_array_clear(array);
+    it = iter_bit_array(array);
+    CU_ASSERT(!iter_has_next(it));
+    iter_free(it);
+
+    bit_array_free(array);
+}
+
+void test_bit_array_map()
+{
+    FILE *file = tmpfile();
+    int fd = fileno(file);
+    bit_array_t *small = bit_array_new(13);
+    bit_array_t *array = bit_array_new(100000);
+    off_t offset = 0;
+
+    bit_array_set(small, 12);
+    for (uint64_t i = 0; i < 100000; i += 7)
+        bit_array_set(array, i);
+
+    // the second array starts at an offset that is not page aligned
+    CU_ASSERT(bit_array_store(small, fd, &offset));
+    CU_ASSERT(offset == 8 + 2);
+    CU_ASSERT(bit_array_store(array, fd, &offset));
+
+    off_t end = offset;
+    offset = 0;
+    bit_array_t *mapped_small = bit_array_map(fd, &offset, false);
+    bit_array_t *mapped = bit_array_map(fd, &offset, true);
+    CU_ASSERT(offset == end);
+    CU_ASSERT(bit_array_map(fd, &offset, false) == NULL);
+
+    if (mapped_small == NULL || mapped == NULL) {
+        CU_ASSERT(false);
+        return;
+    }
+
+    CU_ASSERT(bit_array_length(mapped_small) == 13);
+    CU_ASSERT(bit_array_test(mapped_small, 12));
+    CU_ASSERT(bit_array_length(mapped) == 100000);
+    CU_ASSERT(bit_array_count(mapped) == bit_array_count(array));
+    CU_ASSERT(bit_array_test(mapped, 99995) && !bit_array_test(mapped, 99996));
+
+    // copy-on-write changes stay out of the file
+    bit_array_set(mapped, 1);
+    CU_ASSERT(bit_array_test(mapped, 1));
+    rewind(file);
+    bit_array_t *read_small = bit_array_read(file);
+    bit_array_t *read = bit_array_read(file);
+    CU_ASSERT(read != NULL && !bit_array_test(read, 1));
+    CU_ASSERT(read != NULL && bit_array_count(read) == bit_array_count(array));
+    CU_ASSERT(bit_array_read(file) == NULL);
+
+    bit_array_free(read_small);
+    bit_array_free(read);
+    bit_array_free(mapped_small);
+    bit_array_free(mapped);
+    bit_array_free(small);
+    bit_array_free(array);
+    fclose(file);
+}
+
+void test_bit_array_read_invalid()
+{
+    uint64_t headers[] = { UINT64_MAX, UINT64_MAX - 62, 1024 };
+    uint8_t data[16] = { 0 };
+
+    CU_ASSERT(bit_array_new(UINT64_MAX - 62) == NULL);
+
+    // lengths that overflow, and one longer than the bytes that follow
+    for (int i = 0; i < 3; i++) {
+        FILE *file = tmpfile();
+        uint64_t header = htole64(headers[i]);
+
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(data, 1, sizeof(data), file);
+        rewind(file);
+        CU_ASSERT(bit_array_read(file) == NULL);
+        fclose(file);
+    }
+}
+
+test_t BIT_ARRAY_TESTS[] = {
+    { "put and peek fields", test_bit_array_put_peek },
+    { "copy ranges", test_bit_array_copy },
+    { "unaligned borrowed storage", test_bit_array_wrap_unaligned },
+    { "grow by appending", test_bit_array_grow },
+    { "more than 2^32 bits", test_bit_array_large },
+    { "count, fill and not", test_bit_array_count_fill },
+    { "and, or, xor and shifts", test_bit_array_bitwise },
+    { "find set bits", test_bit_array_find_set },
+    { "map and store files", test_bit_array_map },
+    { "reject invalid lengths", test_bit_array_read_invalid },
+    { NULL }
+};
@@ -0,0 +1,72 @@
+#include <stdint.h>
+#include "tests.h"
+#include "bit_array.h"
+#include "bit_index.h"
+
+int init_suite_bit_index()
+{
+    return 0;
+}
+
+int clean_suite_bit_index()
+{
+    return 0;
+}
+
+// Compare rank and select against a linear scan
+void check_index(bit_array_t *array)
+{
+    bit_index_t *index = bit_index_new(array);
+    uint64_t length = bit_array_length(array);
+    uint64_t ones = 0;
+    uint64_t pos;
+
+    CU_ASSERT(index != NULL);
+    if (index == NULL)
+        return;
+
+    for (uint64_t i = 0; i < length; i++) {
+        CU_ASSERT(bit_index_rank(index, i) == ones);
+
+        if (bit_array_test(array, i)) {
+            CU_ASSERT(bit_index_select(index, ones, &pos) && pos == i);
+            ones++;
+        }
+    }
+
+    CU_ASSERT(bit_index_ones(index) == ones);
+    CU_ASSERT(bit_index_rank(index, length) == ones);
+    CU_ASSERT(!bit_index_select(index, ones, &pos));
+
+    bit_index_free(index);
+}
+
+void test_bit_index_patterns()
+{
+    uint64_t lengths[] = { 0, 1, 63, 512, 4096, 4097, 70000 };
+
+    for (int l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        bit_array_t *array = bit_array_new(lengths[l]);
+        uint32_t seed = 7;
+
+        // dense runs, sparse stretches and empty superblocks
+        for (uint64_t i = 0; i < lengths[l]; i++) {
+            seed = seed * 1103515245 + 12345;
+            uint64_t region = (i / 5000) % 3;
+            if ((region == 0 && (seed >> 16) % 4 != 0) || (region == 1 && (seed >> 16) % 97 == 0))
+                bit_array_set(array, i);
+        }
+
+        check_index(array);
+
+        bit_array_fill(array);
+        check_index(array);
+
+        bit_array_free(array);
+    }
+}
+
+test_t BIT_INDEX_TESTS[] = {
+    { "rank and select", test_bit_index_patterns },
+    { NULL }
+};
@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 #include "tests.h"
 #include "heap.h"
@@ -44,15 +45,13 @@ void test_max_heap_insert()
     int numbers[] = { 5, 10, 6, 4, 7, 8, 1 };
     int length = sizeof(numbers) / sizeof(int);
 
-    heap_t *heap = heap_new_max(length, cmp_ints);
+    heap_t *heap = heap_new_max(1, cmp_ints);
 
+    // the heap grows past its initial capacity
     for (int i = 0; i < length; i++) {
         CU_ASSERT(heap_insert(heap, &numbers[i]) == true);
     }
 
-    int number = 12;
-    CU_ASSERT(heap_insert(heap, &number) == false);
-
     CU_ASSERT(heap_size(heap) == length);
 
     test_max_heap(heap);
@@ -87,15 +86,13 @@ void test_min_heap_insert()
     int numbers[] = { 5, 10, 6, 4, 7, 8, 1 };
     int length = sizeof(numbers) / sizeof(int);
 
-    heap_t *heap = heap_new_min(length, cmp_ints);
+    heap_t *heap = heap_new_min(1, cmp_ints);
 
+    // the heap grows past its initial capacity
     for (int i = 0; i < length; i++) {
         CU_ASSERT(heap_insert(heap, &numbers[i]) == true);
     }
 
-    int number = 12;
-    CU_ASSERT(heap_insert(heap, &number) == false);
-
     CU_ASSERT(heap_size(heap) == length);
 
     test_min_heap(heap);
@@ -103,8 +100,129 @@ void test_min_heap_insert()
     heap_free(heap);
 }
 
+void test_heap_build()
+{
+    int numbers[] = { 5, 10, 6, 4, 7, 8, 1 };
+    int length = sizeof(numbers) / sizeof(int);
+    void *values[7];
+
+    for (int i = 0; i < length; i++) {
+        values[i] = &numbers[i];
+    }
+
+    heap_t *heap = heap_new_max(length, cmp_ints);
+    CU_ASSERT(heap_build(heap, values, length));
+    CU_ASSERT(heap_size(heap) == length);
+    CU_ASSERT(*(int*) heap_get(heap, 0) == 10);
+    heap_free(heap);
+
+    // d-ary heaps extract in order whether built or filled by inserts
+    int many[1000];
+    void *many_values[1000];
+    srand(7);
+    for (int i = 0; i < 1000; i++) {
+        many[i] = rand() % 500;
+        many_values[i] = &many[i];
+    }
+
+    for (int arity = 2; arity <= 8; arity *= 2) {
+        heap = heap_new_arity(0, arity, cmp_ints, min_heapify);
+        CU_ASSERT(heap_arity(heap) == arity);
+        CU_ASSERT(heap_build(heap, many_values, 500));
+        for (int i = 500; i < 1000; i++) {
+            heap_insert(heap, many_values[i]);
+        }
+
+        int previous = -1;
+        bool sorted = true;
+        while (heap_size(heap) > 0) {
+            int value = *(int*) heap_extract(heap);
+            sorted &= (value >= previous);
+            previous = value;
+        }
+        CU_ASSERT(sorted);
+        heap_free(heap);
+    }
+}
+
+void test_heap_handles()
+{
+    int numbers[100];
+    heap_handle_t handles[100];
+    heap_t *heap = heap_new_arity(4, 4, cmp_ints, max_heapify);
+
+    for (int i = 0; i < 100; i++) {
+        numbers[i] = i;
+        handles[i] = heap_push(heap, &numbers[i]);
+        CU_ASSERT(handles[i] != HEAP_INVALID_HANDLE);
+    }
+
+    // raise one value to the top and lower another to the bottom
+    numbers[10] = 1000;
+    CU_ASSERT(heap_update(heap, handles[10]));
+    numbers[99] = -1;
+    CU_ASSERT(heap_update(heap, handles[99]));
+    CU_ASSERT(*(int*) heap_get(heap, 0) == 1000);
+
+    CU_ASSERT(heap_remove(heap, handles[50]) == &numbers[50]);
+    CU_ASSERT(heap_value(heap, handles[50]) == NULL);
+    CU_ASSERT(heap_remove(heap, handles[50]) == NULL);
+    CU_ASSERT(!heap_update(heap, handles[50]));
+    CU_ASSERT(heap_value(heap, handles[20]) == &numbers[20]);
+
+    // a removed value's handle is reused
+    int extra = 50;
+    CU_ASSERT(heap_push(heap, &extra) == handles[50]);
+
+    int previous = 1001;
+    bool sorted = true;
+    CU_ASSERT(heap_size(heap) == 100);
+    while (heap_size(heap) > 0) {
+        int value = *(int*) heap_extract(heap);
+        sorted &= (value <= previous);
+        previous = value;
+    }
+    CU_ASSERT(sorted);
+    CU_ASSERT(previous == -1);
+
+    heap_free(heap);
+}
+
+#define INT_LESS(a, b) ((a) < (b))
+HEAP_DEFINE(int_heap, int, INT_LESS)
+
+void test_heap_define()
+{
+    int_heap_t heap;
+    int value = 0;
+
+    int_heap_init(&heap);
+    CU_ASSERT(int_heap_top(&heap) == NULL);
+    CU_ASSERT(!int_heap_pop(&heap, &value));
+
+    srand(42);
+    for (int i = 0; i < 1000; i++) {
+        CU_ASSERT(int_heap_push(&heap, rand() % 100));
+    }
+    CU_ASSERT(int_heap_size(&heap) == 1000);
+
+    int previous = -1;
+    bool sorted = true;
+    while (int_heap_pop(&heap, &value)) {
+        sorted &= (value >= previous);
+        previous = value;
+    }
+    CU_ASSERT(sorted);
+    CU_ASSERT(int_heap_size(&heap) == 0);
+
+    int_heap_destroy(&heap);
+}
+
 test_t HEAP_TESTS[] = {
     { "max-heap insert", test_max_heap_insert },
     { "min-heap insert", test_min_heap_insert },
+    { "build and d-ary heaps", test_heap_build },
+    { "handles", test_heap_handles },
+    { "generated value heap", test_heap_define },
     { NULL }
 };
@@ -2,6 +2,7 @@
 #include "tests.h"
 #include "heap.h"
 #include "huffman.h"
+#include "memory.h"
 
 int init_suite_huffman()
 {
@@ -59,7 +60,107 @@ void test_min_priority_queue()
     heap_free(heap);
 }
 
+void test_decode_range_sync()
+{
+    char message[] = "abracadabra, said the magician to the rabbit in the hat";
+    size_t length = strlen(message);
+    int tree_size = 0;
+    int unique_letters = 0;
+
+    huffman_node_t *root = huffman_new_tree(message, &tree_size, &unique_letters);
+    char **index = huffman_build_index(root);
+    bit_array_t *bits = huffman_encode(index, message);
+
+    huffman_sync_t *sync = huffman_sync_new(index, message, length, 4);
+    bit_array_t *sync_bits = huffman_sync_encode(sync);
+    huffman_sync_t *decoded = huffman_sync_decode(sync_bits);
+
+    CU_ASSERT(decoded != NULL);
+
+    for (size_t offset = 0; offset <= length; offset++) {
+        char plain[8] = { 0 };
+        char synced[8] = { 0 };
+        size_t expected = (length - offset < 5) ? length - offset : 5;
+
+        CU_ASSERT(huffman_decode_range(root, bits, NULL, offset, 5, plain) == expected);
+        CU_ASSERT(huffman_decode_range(root, bits, decoded, offset, 5, synced) == expected);
+        CU_ASSERT(strncmp(plain, message + offset, expected) == 0);
+        CU_ASSERT(strncmp(synced, message + offset, expected) == 0);
+    }
+
+    huffman_sync_free(sync);
+    huffman_sync_free(decoded);
+    bit_array_free(sync_bits);
+    bit_array_free(bits);
+    huffman_free(root, index);
+}
+
+void test_decode_parallel()
+{
+    size_t length = 50000;
+    char *message = malloc(length + 1);
+    int tree_size = 0;
+    int unique_letters = 0;
+
+    // skewed alphabet so codes have many different lengths
+    unsigned int seed = 1;
+    for (size_t i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        unsigned int r = (seed >> 16) % 1000;
+        message[i] = 'a' + (r < 500 ? 0 : r < 750 ? 1 : r < 875 ? 2 : 3 + r % 20);
+    }
+    message[length] = '\0';
+
+    huffman_node_t *root = huffman_new_tree(message, &tree_size, &unique_letters);
+    char **index = huffman_build_index(root);
+    bit_array_t *bits = huffman_encode(index, message);
+
+    int threads[] = { 1, 2, 3, 7, 16 };
+    for (int i = 0; i < sizeof(threads) / sizeof(int); i++) {
+        char *decoded = huffman_decode_parallel(root, bits, threads[i]);
+        CU_ASSERT(decoded != NULL);
+        CU_ASSERT_STRING_EQUAL(decoded, message);
+        memory_free(MEMORY_HUFFMAN, decoded);
+    }
+
+    bit_array_free(bits);
+    huffman_free(root, index);
+    free(message);
+}
+
+void test_single_letter()
+{
+    char message[1001];
+    int tree_size = 0;
+    int unique_letters = 0;
+
+    // one bit per letter, more letters than the decode buffer starts with
+    memset(message, 'a', sizeof(message) - 1);
+    message[sizeof(message) - 1] = '\0';
+
+    huffman_node_t *root = huffman_new_tree(message, &tree_size, &unique_letters);
+    char **index = huffman_build_index(root);
+    bit_array_t *bits = huffman_encode(index, message);
+    bit_array_t *tree_bits = huffman_encode_tree(root, tree_size, unique_letters);
+
+    CU_ASSERT(unique_letters == 1);
+    CU_ASSERT(bit_array_length(bits) == strlen(message));
+
+    huffman_node_t *decoded_root = huffman_build_tree(tree_bits);
+    char *decoded = huffman_decode(decoded_root, bits);
+    CU_ASSERT_STRING_EQUAL(decoded, message);
+
+    memory_free(MEMORY_HUFFMAN, decoded);
+    huffman_free(decoded_root, NULL);
+    bit_array_free(tree_bits);
+    bit_array_free(bits);
+    huffman_free(root, index);
+}
+
 test_t HUFFMAN_TESTS[] = {
     { "min-priority queue", test_min_priority_queue },
+    { "decode range with sync points", test_decode_range_sync },
+    { "parallel decode", test_decode_parallel },
+    { "single letter alphabet", test_single_letter },
     { NULL }
 };
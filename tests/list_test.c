@@ -0,0 +1,223 @@
+#include "tests.h"
+#include "list.h"
+#include "ilist.h"
+#include "ulist.h"
+#include "memory.h"
+
+int init_suite_list()
+{
+    return 0;
+}
+
+int clean_suite_list()
+{
+    return 0;
+}
+
+static int cmp_ints(void *a, void *b)
+{
+    return *(int*)a - *(int*)b;
+}
+
+static void free_nothing(void *value)
+{
+}
+
+void test_list_pooled()
+{
+    int numbers[1000];
+    list_t *list = list_new_pooled(cmp_ints, free_nothing);
+
+    for (int i = 0; i < 1000; i++) {
+        numbers[i] = i;
+        list_append(list, &numbers[i]);
+    }
+    CU_ASSERT(list_length(list) == 1000);
+    CU_ASSERT(*(int*) list_get(list, 500) == 500);
+
+    // removed elements are reused by later inserts
+    void *value;
+    for (int i = 0; i < 500; i++) {
+        CU_ASSERT(list_remove(list, 0, &value));
+    }
+    CU_ASSERT(*(int*) list_first(list) == 500);
+
+    for (int i = 0; i < 500; i++) {
+        list_prepend(list, &numbers[499 - i]);
+    }
+    CU_ASSERT(list_length(list) == 1000);
+
+    bool ordered = true;
+    iter_t *it = iter_list(list);
+    for (int i = 0; iter_has_next(it); i++) {
+        ordered &= (*(int*) iter_next(it) == i);
+    }
+    iter_free(it);
+    CU_ASSERT(ordered);
+
+    CU_ASSERT(list_insert(list, 10, &numbers[0]));
+    CU_ASSERT(list_get(list, 10) == &numbers[0]);
+    CU_ASSERT(list_delete(list, &numbers[999]));
+    CU_ASSERT(*(int*) list_last(list) == 998);
+
+    list_clear(list);
+    CU_ASSERT(list_length(list) == 0);
+    list_append(list, &numbers[1]);
+    CU_ASSERT(list_first(list) == &numbers[1]);
+
+    list_free(list);
+}
+
+typedef struct job {
+    int id;
+    ilist_link_t link;
+} job_t;
+
+void test_ilist()
+{
+    job_t jobs[4] = { { 0 }, { 1 }, { 2 }, { 3 } };
+    ilist_t list;
+
+    ilist_init(&list);
+    CU_ASSERT(ilist_pop_first(&list) == NULL);
+
+    ilist_append(&list, &jobs[1].link);
+    ilist_append(&list, &jobs[3].link);
+    ilist_prepend(&list, &jobs[0].link);
+    ilist_insert_before(&list, &jobs[2].link, &jobs[3].link);
+    CU_ASSERT(ilist_length(&list) == 4);
+
+    bool ordered = true;
+    iter_t *it = iter_ilist(&list);
+    for (int i = 0; iter_has_next(it); i++) {
+        ordered &= (ilist_entry(iter_next(it), job_t, link)->id == i);
+    }
+    iter_free(it);
+    CU_ASSERT(ordered);
+
+    ilist_remove(&list, &jobs[3].link);
+    CU_ASSERT(ilist_entry(ilist_last(&list), job_t, link) == &jobs[2]);
+
+    it = iter_ilist_reverse(&list);
+    CU_ASSERT(ilist_entry(iter_next(it), job_t, link)->id == 2);
+    iter_free(it);
+
+    CU_ASSERT(ilist_pop_first(&list) == &jobs[0].link);
+    ilist_remove(&list, &jobs[2].link);
+    ilist_remove(&list, &jobs[1].link);
+    CU_ASSERT(ilist_length(&list) == 0);
+    CU_ASSERT(ilist_first(&list) == NULL && ilist_last(&list) == NULL);
+}
+
+// Apply the same random operations to a list and an unrolled list
+void test_ulist()
+{
+    static int numbers[2000];
+    list_t *list = list_new(cmp_ints, free_nothing);
+    ulist_t *ulist = ulist_new(cmp_ints, free_nothing);
+    bool same = true;
+
+    srand(3);
+    for (int i = 0; i < 2000; i++) {
+        numbers[i] = i;
+        int index = (list_length(list) > 0) ? rand() % list_length(list) : 0;
+        void *a = NULL;
+        void *b = NULL;
+
+        switch (rand() % 6) {
+        case 0:
+            list_append(list, &numbers[i]);
+            ulist_append(ulist, &numbers[i]);
+            break;
+        case 1:
+            list_prepend(list, &numbers[i]);
+            ulist_prepend(ulist, &numbers[i]);
+            break;
+        case 2:
+        case 3:
+            same &= (list_insert(list, index, &numbers[i]) ==
+                     ulist_insert(ulist, index, &numbers[i]));
+            break;
+        case 4:
+            same &= (list_remove(list, index, &a) == ulist_remove(ulist, index, &b));
+            same &= (a == b);
+            break;
+        case 5:
+            same &= (list_get(list, index) == ulist_get(ulist, index));
+            break;
+        }
+    }
+
+    CU_ASSERT(same);
+    CU_ASSERT(list_length(list) == ulist_length(ulist));
+    CU_ASSERT(list_first(list) == ulist_first(ulist));
+    CU_ASSERT(list_last(list) == ulist_last(ulist));
+    CU_ASSERT(ulist_get(ulist, ulist_length(ulist)) == NULL);
+
+    iter_t *expected = iter_list_reverse(list);
+    iter_t *it = iter_ulist_reverse(ulist);
+    while (iter_has_next(expected)) {
+        same &= (iter_next(expected) == iter_next(it));
+    }
+    CU_ASSERT(same && !iter_has_next(it));
+    iter_free(expected);
+    iter_free(it);
+
+    it = iter_ulist(ulist);
+    int count = 0;
+    while (iter_has_next(it)) {
+        same &= (iter_next(it) == list_get(list, count++));
+    }
+    iter_free(it);
+    CU_ASSERT(same);
+
+    // delete every value from the front, which drains and merges chunks
+    while (list_length(list) > 0) {
+        void *value = list_first(list);
+        list_delete(list, value);
+        same &= ulist_has_value(ulist, value) && ulist_delete(ulist, value);
+    }
+    CU_ASSERT(same);
+    CU_ASSERT(ulist_length(ulist) == 0 && ulist_first(ulist) == NULL);
+
+    list_free(list);
+    ulist_free(ulist);
+}
+
+// Appends and prepends that cannot allocate a chunk fail without changing the list
+void test_ulist_out_of_memory()
+{
+    static int numbers[30];
+    ulist_t *ulist = ulist_new(cmp_ints, free_nothing);
+
+    for (int i = 0; i < 29; i++) {
+        numbers[i] = i;
+        CU_ASSERT(ulist_append(ulist, &numbers[i]));
+    }
+
+    // the only chunk is full, so both ends need a new one
+    memory_accounting_t *accounting = memory_accounting_new(NULL, 1);
+    allocator_t allocator = memory_accounting_allocator(accounting);
+    memory_set_allocator(&allocator);
+
+    CU_ASSERT(!ulist_append(ulist, &numbers[29]));
+    CU_ASSERT(!ulist_prepend(ulist, &numbers[29]));
+    CU_ASSERT(!ulist_insert(ulist, -1, &numbers[29]));
+
+    memory_set_allocator(NULL);
+    memory_accounting_free(accounting);
+
+    CU_ASSERT(ulist_length(ulist) == 29);
+    CU_ASSERT(ulist_first(ulist) == &numbers[0]);
+    CU_ASSERT(ulist_last(ulist) == &numbers[28]);
+
+    ulist_free(ulist);
+}
+
+test_t LIST_TESTS[] = {
+    { "pooled list", test_list_pooled },
+    { "intrusive list", test_ilist },
+    { "unrolled list", test_ulist },
+    { "unrolled list out of memory", test_ulist_out_of_memory },
+    { NULL }
+};
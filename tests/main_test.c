@@ -20,6 +20,30 @@ bool add_test_suite(char *name, CU_InitializeFunc pInit, CU_CleanupFunc pClean,
     return (pSuite == NULL || !add_tests(pSuite, tests));
 }
 
+// Check that braces and brackets outside strings are balanced
+bool json_balanced(const char *json)
+{
+    int depth = 0;
+    bool string = false;
+
+    for (const char *c = json; *c != '\0'; c++) {
+        if (string) {
+            if (*c == '\\' && c[1] != '\0')
+                c++;
+            else if (*c == '"')
+                string = false;
+        } else if (*c == '"') {
+            string = true;
+        } else if (*c == '{' || *c == '[') {
+            depth++;
+        } else if ((*c == '}' || *c == ']') && --depth < 0) {
+            return false;
+        }
+    }
+
+    return depth == 0 && !string;
+}
+
 int main()
 {
     // Initialize
@@ -27,12 +51,51 @@ int main()
         return CU_get_error();
     }
 
+    // Bit array tests
+    if (add_test_suite("Bit Array Test Suite", init_suite_bit_array, clean_suite_bit_array,
+                       BIT_ARRAY_TESTS)) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    // Rank and select index tests
+    if (add_test_suite("Bit Index Test Suite", init_suite_bit_index, clean_suite_bit_index,
+                       BIT_INDEX_TESTS)) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
     // Heap tests
     if (add_test_suite("Heap Test Suite", init_suite_heap, clean_suite_heap, HEAP_TESTS)) {
         CU_cleanup_registry();
         return CU_get_error();
     }
 
+    // List tests
+    if (add_test_suite("List Test Suite", init_suite_list, clean_suite_list, LIST_TESTS)) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    // Stack tests
+    if (add_test_suite("Stack Test Suite", init_suite_stack, clean_suite_stack, STACK_TESTS)) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    // Binary search tree tests
+    if (add_test_suite("Tree Test Suite", init_suite_tree, clean_suite_tree, TREE_TESTS)) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    // MultiQueue tests
+    if (add_test_suite("MultiQueue Test Suite", init_suite_multiqueue, clean_suite_multiqueue,
+                       MULTIQUEUE_TESTS)) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
     // Huffman tests
     if (add_test_suite("Huffman Test Suite", init_suite_huffman, clean_suite_huffman,
                        HUFFMAN_TESTS)) {
@@ -40,6 +103,38 @@ int main()
         return CU_get_error();
     }
 
+    // Asynchronous I/O tests
+    if (add_test_suite("AIO Test Suite", init_suite_aio, clean_suite_aio, AIO_TESTS)) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    // Reader tests
+    if (add_test_suite("Reader Test Suite", init_suite_reader, clean_suite_reader,
+                       READER_TESTS)) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    // Memory allocator tests
+    if (add_test_suite("Memory Test Suite", init_suite_memory, clean_suite_memory,
+                       MEMORY_TESTS)) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    // Statistics tests
+    if (add_test_suite("Stats Test Suite", init_suite_stats, clean_suite_stats, STATS_TESTS)) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
+    // Tracer tests
+    if (add_test_suite("Trace Test Suite", init_suite_trace, clean_suite_trace, TRACE_TESTS)) {
+        CU_cleanup_registry();
+        return CU_get_error();
+    }
+
     // Run tests
     CU_basic_set_mode(CU_BRM_VERBOSE);
     CU_basic_run_tests();
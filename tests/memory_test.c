@@ -0,0 +1,151 @@
+#include <stdint.h>
+#include <string.h>
+#include "tests.h"
+#include "bit_array.h"
+#include "huffman.h"
+#include "memory.h"
+
+int init_suite_memory()
+{
+    return 0;
+}
+
+int clean_suite_memory()
+{
+    memory_set_allocator(NULL);
+    return 0;
+}
+
+void test_memory_accounting()
+{
+    memory_usage_t usage;
+    memory_accounting_t *accounting = memory_accounting_new(NULL, 0);
+    allocator_t allocator = memory_accounting_allocator(accounting);
+
+    memory_set_allocator(&allocator);
+
+    char *a = memory_malloc(MEMORY_HEAP, 100);
+    char *b = memory_calloc(MEMORY_LIST, 10, 30);
+    b = memory_realloc(MEMORY_LIST, b, 500);
+    memory_free(MEMORY_HEAP, a);
+
+    memory_accounting_usage(accounting, MEMORY_HEAP, &usage);
+    CU_ASSERT(usage.current == 0);
+    CU_ASSERT(usage.peak == 100);
+    CU_ASSERT(usage.allocations == 1);
+    CU_ASSERT(usage.frees == 1);
+
+    memory_accounting_usage(accounting, MEMORY_LIST, &usage);
+    CU_ASSERT(usage.current == 500);
+    CU_ASSERT(usage.peak == 500);
+
+    memory_accounting_usage(accounting, MEMORY_NUM_SUBSYSTEMS, &usage);
+    CU_ASSERT(usage.current == 500);
+    CU_ASSERT(usage.peak == 600);
+
+    memory_free(MEMORY_LIST, b);
+    memory_set_allocator(NULL);
+    memory_accounting_free(accounting);
+}
+
+void test_memory_limit()
+{
+    memory_usage_t usage;
+    memory_accounting_t *accounting = memory_accounting_new(NULL, 1000);
+    allocator_t allocator = memory_accounting_allocator(accounting);
+
+    memory_set_allocator(&allocator);
+
+    char *a = memory_malloc(MEMORY_OTHER, 800);
+    CU_ASSERT(a != NULL);
+    CU_ASSERT(memory_malloc(MEMORY_OTHER, 300) == NULL);
+    CU_ASSERT(memory_realloc(MEMORY_OTHER, a, 1200) == NULL);
+
+    memory_accounting_usage(accounting, MEMORY_NUM_SUBSYSTEMS, &usage);
+    CU_ASSERT(usage.current == 800);
+
+    memory_free(MEMORY_OTHER, a);
+    memory_set_allocator(NULL);
+    memory_accounting_free(accounting);
+}
+
+void test_memory_aligned()
+{
+    memory_usage_t usage;
+    memory_accounting_t *accounting = memory_accounting_new(NULL, 0);
+    allocator_t allocator = memory_accounting_allocator(accounting);
+    size_t alignments[] = { sizeof(void *), 64, 256, 4096 };
+    void *blocks[4];
+
+    // aligned through the C library, then through the accounting allocator
+    for (int i = 0; i < 4; i++) {
+        blocks[i] = memory_aligned_alloc(MEMORY_LIST, alignments[i], 100);
+        CU_ASSERT(blocks[i] != NULL && (uintptr_t) blocks[i] % alignments[i] == 0);
+        memory_free(MEMORY_LIST, blocks[i]);
+    }
+
+    memory_set_allocator(&allocator);
+
+    for (int i = 0; i < 4; i++) {
+        blocks[i] = memory_aligned_alloc(MEMORY_LIST, alignments[i], 100);
+        CU_ASSERT(blocks[i] != NULL && (uintptr_t) blocks[i] % alignments[i] == 0);
+        memset(blocks[i], 0xff, 100);
+    }
+
+    memory_accounting_usage(accounting, MEMORY_LIST, &usage);
+    CU_ASSERT(usage.current == 400);
+    CU_ASSERT(usage.allocations == 4);
+
+    for (int i = 0; i < 4; i++)
+        memory_free(MEMORY_LIST, blocks[i]);
+
+    memory_accounting_usage(accounting, MEMORY_LIST, &usage);
+    CU_ASSERT(usage.current == 0);
+    CU_ASSERT(usage.frees == 4);
+
+    memory_set_allocator(NULL);
+    memory_accounting_free(accounting);
+}
+
+void test_memory_huffman_round_trip()
+{
+    int tree_size = 0;
+    int unique_letters = 0;
+    char *message = "so much depends upon a red wheel barrow";
+    memory_usage_t usage;
+    memory_accounting_t *accounting = memory_accounting_new(NULL, 0);
+    allocator_t allocator = memory_accounting_allocator(accounting);
+
+    memory_set_allocator(&allocator);
+
+    huffman_node_t *root = huffman_new_tree(message, &tree_size, &unique_letters);
+    char **index = huffman_build_index(root);
+    bit_array_t *bits = huffman_encode(index, message);
+    char *decoded = huffman_decode(root, bits);
+
+    CU_ASSERT_STRING_EQUAL(decoded, message);
+
+    memory_free(MEMORY_HUFFMAN, decoded);
+    bit_array_free(bits);
+    huffman_free(root, index);
+
+    // everything allocated by the modules is accounted for and released
+    memory_accounting_usage(accounting, MEMORY_HUFFMAN, &usage);
+    CU_ASSERT(usage.allocations > 0);
+    memory_accounting_usage(accounting, MEMORY_BIT_ARRAY, &usage);
+    CU_ASSERT(usage.allocations > 0);
+    memory_accounting_usage(accounting, MEMORY_NUM_SUBSYSTEMS, &usage);
+    CU_ASSERT(usage.current == 0);
+    CU_ASSERT(usage.allocations == usage.frees);
+
+    memory_set_allocator(NULL);
+    memory_accounting_free(accounting);
+}
+
+test_t MEMORY_TESTS[] = {
+    { "accounting per subsystem", test_memory_accounting },
+    { "accounting limit", test_memory_limit },
+    { "aligned allocation", test_memory_aligned },
+    { "huffman round trip", test_memory_huffman_round_trip },
+    { NULL }
+};
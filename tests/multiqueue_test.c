@@ -0,0 +1,104 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include "tests.h"
+#include "multiqueue.h"
+
+#define THREADS 4
+#define VALUES_PER_THREAD 10000
+
+int init_suite_multiqueue()
+{
+    return 0;
+}
+
+int clean_suite_multiqueue()
+{
+    return 0;
+}
+
+static int cmp_values(void *a, void *b)
+{
+    return (*(int*)a > *(int*)b) - (*(int*)a < *(int*)b);
+}
+
+void test_multiqueue_single_heap()
+{
+    int numbers[] = { 5, 10, 6, 4, 7, 8, 1 };
+    multiqueue_t *queue = multiqueue_new(1, cmp_values, true);
+
+    for (int i = 0; i < 7; i++) {
+        CU_ASSERT(multiqueue_insert(queue, &numbers[i]));
+    }
+    CU_ASSERT(multiqueue_size(queue) == 7);
+
+    // a single heap gives exact ordering
+    int expected[] = { 10, 8, 7, 6, 5, 4, 1 };
+    for (int i = 0; i < 7; i++) {
+        CU_ASSERT(*(int*) multiqueue_extract(queue) == expected[i]);
+    }
+    CU_ASSERT(multiqueue_extract(queue) == NULL);
+
+    multiqueue_free(queue);
+}
+
+static int values[THREADS * VALUES_PER_THREAD];
+static atomic_int seen[THREADS * VALUES_PER_THREAD];
+static multiqueue_t *shared;
+
+static void *insert_and_extract(void *arg)
+{
+    int first = (long) arg * VALUES_PER_THREAD;
+
+    for (int i = first; i < first + VALUES_PER_THREAD; i++) {
+        multiqueue_insert(shared, &values[i]);
+
+        if (i % 2 == 0) {
+            int *value = multiqueue_extract(shared);
+            if (value != NULL)
+                atomic_fetch_add(&seen[value - values], 1);
+        }
+    }
+
+    return NULL;
+}
+
+void test_multiqueue_threads()
+{
+    pthread_t threads[THREADS];
+
+    shared = multiqueue_new(0, cmp_values, false);
+    CU_ASSERT(multiqueue_queues(shared) >= 2);
+
+    for (int i = 0; i < THREADS * VALUES_PER_THREAD; i++) {
+        values[i] = i;
+        atomic_store(&seen[i], 0);
+    }
+
+    for (long t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, insert_and_extract, (void *) t);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    int *value;
+    while ((value = multiqueue_extract(shared)) != NULL) {
+        atomic_fetch_add(&seen[value - values], 1);
+    }
+
+    // every value comes out exactly once
+    bool once = true;
+    for (int i = 0; i < THREADS * VALUES_PER_THREAD; i++) {
+        once &= (atomic_load(&seen[i]) == 1);
+    }
+    CU_ASSERT(once);
+    CU_ASSERT(multiqueue_size(shared) == 0);
+
+    multiqueue_free(shared);
+}
+
+test_t MULTIQUEUE_TESTS[] = {
+    { "single heap order", test_multiqueue_single_heap },
+    { "insert and extract from threads", test_multiqueue_threads },
+    { NULL }
+};
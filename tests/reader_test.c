@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "tests.h"
+#include "huffman.h"
+#include "memory.h"
+#include "reader.h"
+
+static char path[] = "/tmp/huffman_reader_XXXXXX";
+
+static char message[] = "the quick brown fox jumps over the lazy dog, again and again";
+
+// "the quick brown fox jumps over the lazy dog" encoded by the first release,
+// with 32-bit lengths and no file header
+static const uint8_t legacy_file[] = {
+    0x17, 0x01, 0x00, 0x00, 0xa0, 0x67, 0xb3, 0xae, 0xed, 0xd1, 0xb9, 0xa5, 0x50, 0x8d,
+    0x68, 0xd8, 0x44, 0xb7, 0x0e, 0xd0, 0xaa, 0xb5, 0xb6, 0xda, 0xf4, 0xd2, 0x54, 0xa7,
+    0x16, 0x12, 0xa0, 0x47, 0xbb, 0x2e, 0x74, 0x6c, 0xac, 0x7b, 0x73, 0xc7, 0x00, 0x00,
+    0x00, 0xb7, 0xd7, 0x1e, 0x94, 0x6f, 0x9c, 0x6e, 0xfc, 0xce, 0x41, 0x1e, 0x0b, 0x98,
+    0xbc, 0x18, 0x5d, 0xb5, 0xdd, 0x5e, 0xcb, 0x4c, 0x0e, 0x66, 0xf9, 0x2b
+};
+
+static const char legacy_message[] = "the quick brown fox jumps over the lazy dog\n";
+
+static void write_header(FILE *file)
+{
+    uint8_t header[HUFFMAN_HEADER_SIZE];
+
+    huffman_header_encode(header);
+    fwrite(header, sizeof(header), 1, file);
+}
+
+int init_suite_reader()
+{
+    int tree_size = 0;
+    int unique_letters = 0;
+
+    int fd = mkstemp(path);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    FILE *file = fdopen(fd, "w");
+
+    huffman_node_t *root = huffman_new_tree(message, &tree_size, &unique_letters);
+    char **index = huffman_build_index(root);
+
+    bit_array_t *bits = huffman_encode(index, message);
+    bit_array_t *tree_bits = huffman_encode_tree(root, tree_size, unique_letters);
+
+    write_header(file);
+    bit_array_write(tree_bits, file);
+    bit_array_write(bits, file);
+    fclose(file);
+
+    huffman_free(root, index);
+    bit_array_free(bits);
+    bit_array_free(tree_bits);
+
+    return 0;
+}
+
+int clean_suite_reader()
+{
+    unlink(path);
+    return 0;
+}
+
+void test_reader_full()
+{
+    char buf[sizeof(message)] = { 0 };
+    reader_t *reader = reader_open(path);
+
+    CU_ASSERT(reader != NULL);
+    CU_ASSERT(reader_read(reader, 0, sizeof(message), buf) == strlen(message));
+    CU_ASSERT_STRING_EQUAL(buf, message);
+
+    reader_close(reader);
+}
+
+void test_reader_range()
+{
+    char buf[16] = { 0 };
+    reader_t *reader = reader_open(path);
+
+    CU_ASSERT(reader_read(reader, 4, 5, buf) == 5);
+    CU_ASSERT_STRING_EQUAL(buf, "quick");
+
+    memset(buf, 0, sizeof(buf));
+    CU_ASSERT(reader_read(reader, strlen(message) - 3, 10, buf) == 3);
+    CU_ASSERT_STRING_EQUAL(buf, "ain");
+
+    CU_ASSERT(reader_read(reader, strlen(message) + 10, 10, buf) == 0);
+
+    reader_close(reader);
+}
+
+void test_reader_invalid()
+{
+    CU_ASSERT(reader_open("/nonexistent/file") == NULL);
+
+    char empty[] = "/tmp/huffman_empty_XXXXXX";
+    int fd = mkstemp(empty);
+    CU_ASSERT(write(fd, "\xff\xff", 2) == 2);
+    close(fd);
+
+    CU_ASSERT(reader_open(empty) == NULL);
+    unlink(empty);
+}
+
+// Write a file with the given tree bits and a short message
+static bool reader_opens_tree(const char *tree, bool expected)
+{
+    char corrupt[] = "/tmp/huffman_tree_XXXXXX";
+    int fd = mkstemp(corrupt);
+    FILE *file = fdopen(fd, "w");
+    bit_array_t *tree_bits = bit_array_new(strlen(tree));
+    bit_array_t *bits = bit_array_new(8);
+
+    for (size_t i = 0; i < strlen(tree); i++) {
+        if (tree[i] == '1')
+            bit_array_set(tree_bits, i);
+    }
+
+    write_header(file);
+    bit_array_write(tree_bits, file);
+    bit_array_write(bits, file);
+    fclose(file);
+    bit_array_free(tree_bits);
+    bit_array_free(bits);
+
+    reader_t *reader = reader_open(corrupt);
+    unlink(corrupt);
+
+    if (reader != NULL)
+        reader_close(reader);
+
+    return (reader != NULL) == expected;
+}
+
+void test_reader_invalid_tree()
+{
+    // a lone internal node, a node with one child, a truncated leaf, trailing bits
+    CU_ASSERT(reader_opens_tree("0", false));
+    CU_ASSERT(reader_opens_tree("0101100001", false));
+    CU_ASSERT(reader_opens_tree("01011000011", false));
+    CU_ASSERT(reader_opens_tree("101100001" "0", false));
+
+    // a single letter and two letters
+    CU_ASSERT(reader_opens_tree("101100001", true));
+    CU_ASSERT(reader_opens_tree("0101100001" "101100010", true));
+}
+
+void test_reader_legacy()
+{
+    char legacy[] = "/tmp/huffman_legacy_XXXXXX";
+    char buf[sizeof(legacy_message)] = { 0 };
+    int fd = mkstemp(legacy);
+
+    CU_ASSERT(write(fd, legacy_file, sizeof(legacy_file)) == sizeof(legacy_file));
+    close(fd);
+
+    CU_ASSERT(huffman_header_version(legacy_file, sizeof(legacy_file)) == HUFFMAN_VERSION_LEGACY);
+
+    // through the mapping reader
+    reader_t *reader = reader_open(legacy);
+    unlink(legacy);
+
+    CU_ASSERT(reader != NULL);
+    if (reader != NULL) {
+        CU_ASSERT(reader_read(reader, 0, sizeof(buf), buf) == strlen(legacy_message));
+        CU_ASSERT_STRING_EQUAL(buf, legacy_message);
+        reader_close(reader);
+    }
+
+    // through the stream reader used by the command line decoder
+    FILE *file = fmemopen((void *) legacy_file, sizeof(legacy_file), "r");
+    bit_array_t *tree_bits = bit_array_read_legacy(file);
+    bit_array_t *bits = bit_array_read_legacy(file);
+    fclose(file);
+
+    CU_ASSERT(tree_bits != NULL && bits != NULL);
+    if (tree_bits != NULL && bits != NULL) {
+        huffman_node_t *root = huffman_build_tree(tree_bits);
+        char *decoded = huffman_decode(root, bits);
+
+        CU_ASSERT_STRING_EQUAL(decoded, legacy_message);
+        memory_free(MEMORY_HUFFMAN, decoded);
+        huffman_free(root, NULL);
+    }
+
+    if (tree_bits != NULL)
+        bit_array_free(tree_bits);
+    if (bits != NULL)
+        bit_array_free(bits);
+}
+
+void test_reader_unknown_version()
+{
+    char future[] = "/tmp/huffman_future_XXXXXX";
+    uint8_t header[HUFFMAN_HEADER_SIZE];
+    int fd = mkstemp(future);
+
+    huffman_header_encode(header);
+    header[HUFFMAN_MAGIC_SIZE] = HUFFMAN_VERSION + 1;
+    CU_ASSERT(write(fd, header, sizeof(header)) == sizeof(header));
+    CU_ASSERT(write(fd, legacy_file, sizeof(legacy_file)) == sizeof(legacy_file));
+    close(fd);
+
+    CU_ASSERT(huffman_header_version(header, sizeof(header)) == HUFFMAN_VERSION + 1);
+    CU_ASSERT(reader_open(future) == NULL);
+    unlink(future);
+}
+
+test_t READER_TESTS[] = {
+    { "read everything", test_reader_full },
+    { "read range", test_reader_range },
+    { "reject invalid files", test_reader_invalid },
+    { "reject invalid trees", test_reader_invalid_tree },
+    { "read legacy files", test_reader_legacy },
+    { "reject unknown versions", test_reader_unknown_version },
+    { NULL }
+};
@@ -0,0 +1,154 @@
+#include <pthread.h>
+#include "tests.h"
+#include "lfstack.h"
+#include "stack.h"
+
+int init_suite_stack()
+{
+    return 0;
+}
+
+int clean_suite_stack()
+{
+    return 0;
+}
+
+void test_stack_push_pop()
+{
+    int numbers[1000];
+    stack2_t *stack = stack_new(NULL, NULL);
+
+    CU_ASSERT(stack_pop(stack) == NULL);
+    CU_ASSERT(stack_peek(stack) == NULL);
+
+    for (int i = 0; i < 1000; i++) {
+        numbers[i] = i;
+        stack_push(stack, &numbers[i]);
+    }
+    CU_ASSERT(stack_length(stack) == 1000);
+    CU_ASSERT(stack_peek(stack) == &numbers[999]);
+
+    // shrinking as it empties keeps the values intact
+    stack_set_shrink(stack, true);
+    bool ordered = true;
+    for (int i = 999; i >= 10; i--) {
+        ordered &= (stack_pop(stack) == &numbers[i]);
+    }
+    CU_ASSERT(ordered);
+    CU_ASSERT(stack_length(stack) == 10);
+
+    stack_clear(stack);
+    CU_ASSERT(stack_length(stack) == 0);
+    CU_ASSERT(stack_reserve(stack, 100));
+
+    stack_free(stack);
+}
+
+void test_stack_iter()
+{
+    int numbers[] = { 1, 2, 3 };
+    stack2_t *stack = stack_new(NULL, NULL);
+
+    iter_t *it = iter_stack(stack);
+    CU_ASSERT(!iter_has_next(it));
+    iter_free(it);
+
+    it = iter_stack_reverse(stack);
+    CU_ASSERT(!iter_has_next(it));
+    iter_free(it);
+
+    for (int i = 0; i < 3; i++) {
+        stack_push(stack, &numbers[i]);
+    }
+
+    // bottom to top, then top to bottom
+    it = iter_stack(stack);
+    CU_ASSERT(iter_next(it) == &numbers[0]);
+    CU_ASSERT(iter_next(it) == &numbers[1]);
+    CU_ASSERT(iter_next(it) == &numbers[2]);
+    CU_ASSERT(!iter_has_next(it));
+    iter_free(it);
+
+    it = iter_stack_reverse(stack);
+    CU_ASSERT(iter_next(it) == &numbers[2]);
+    CU_ASSERT(iter_next(it) == &numbers[1]);
+    CU_ASSERT(iter_next(it) == &numbers[0]);
+    CU_ASSERT(!iter_has_next(it));
+    iter_free(it);
+
+    stack_free(stack);
+}
+
+#define LF_THREADS 4
+#define LF_NODES 64
+#define LF_ROUNDS 100000
+
+typedef struct buffer {
+    long uses;
+    lfstack_node_t node;
+} buffer_t;
+
+static lfstack_t free_list;
+
+// Take buffers off the shared free list and put them back
+static void *recycle_buffers(void *arg)
+{
+    for (int i = 0; i < LF_ROUNDS; i++) {
+        lfstack_node_t *node = lfstack_pop(&free_list);
+
+        if (node != NULL) {
+            lfstack_entry(node, buffer_t, node)->uses++;
+            lfstack_push(&free_list, node);
+        }
+    }
+
+    return NULL;
+}
+
+void test_lfstack()
+{
+    static buffer_t buffers[LF_NODES];
+    pthread_t threads[LF_THREADS];
+
+    lfstack_init(&free_list);
+    CU_ASSERT(lfstack_empty(&free_list));
+    CU_ASSERT(lfstack_pop(&free_list) == NULL);
+
+    // push all but the last buffer as one chain
+    for (int i = 0; i < LF_NODES - 2; i++) {
+        buffers[i].node.next = &buffers[i + 1].node;
+    }
+    lfstack_push_batch(&free_list, &buffers[0].node, &buffers[LF_NODES - 2].node);
+    lfstack_push(&free_list, &buffers[LF_NODES - 1].node);
+    CU_ASSERT(lfstack_pop(&free_list) == &buffers[LF_NODES - 1].node);
+    CU_ASSERT(lfstack_pop(&free_list) == &buffers[0].node);
+    lfstack_push(&free_list, &buffers[LF_NODES - 1].node);
+    lfstack_push(&free_list, &buffers[0].node);
+
+    for (int t = 0; t < LF_THREADS; t++) {
+        pthread_create(&threads[t], NULL, recycle_buffers, NULL);
+    }
+    for (int t = 0; t < LF_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    // no buffer was lost or handed to two threads at once
+    int count = 0;
+    long uses = 0;
+    for (lfstack_node_t *node = lfstack_pop_all(&free_list); node != NULL; node = node->next) {
+        count++;
+    }
+    for (int i = 0; i < LF_NODES; i++) {
+        uses += buffers[i].uses;
+    }
+    CU_ASSERT(count == LF_NODES);
+    CU_ASSERT(uses == (long) LF_THREADS * LF_ROUNDS);
+    CU_ASSERT(lfstack_empty(&free_list));
+}
+
+test_t STACK_TESTS[] = {
+    { "push and pop", test_stack_push_pop },
+    { "iterators", test_stack_iter },
+    { "lock-free stack", test_lfstack },
+    { NULL }
+};
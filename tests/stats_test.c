@@ -0,0 +1,114 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests.h"
+#include "memory.h"
+#include "stats.h"
+
+int init_suite_stats()
+{
+    return 0;
+}
+
+int clean_suite_stats()
+{
+    memory_set_allocator(NULL);
+    return 0;
+}
+
+void test_stats_entropy()
+{
+    uint64_t freq[256] = { 0 };
+
+    // a single symbol carries no information
+    freq['a'] = 10;
+    CU_ASSERT(stats_entropy(freq) == 0);
+
+    // equally likely symbols need log2 of their count
+    freq['b'] = 10;
+    CU_ASSERT(fabs(stats_entropy(freq) - 1) < 1e-9);
+
+    for (int i = 0; i < 256; i++)
+        freq[i] = 3;
+    CU_ASSERT(fabs(stats_entropy(freq) - 8) < 1e-9);
+
+    // p = 1/2, 1/4, 1/4
+    memset(freq, 0, sizeof(freq));
+    freq['a'] = 2;
+    freq['b'] = 1;
+    freq['c'] = 1;
+    CU_ASSERT(fabs(stats_entropy(freq) - 1.5) < 1e-9);
+}
+
+void test_stats_print_json()
+{
+    char *json = NULL;
+    size_t size = 0;
+    FILE *file = open_memstream(&json, &size);
+    stats_t stats;
+
+    stats_init(&stats, NULL, NULL);
+    stats.stage_ns[STATS_ENCODE] = 2500000;
+    stats.bytes_in = 5000000000ULL;
+    stats.bytes_out = 3000000000ULL;
+    stats.blocks = 3;
+    stats.symbols = 5000000000ULL;
+    stats.encoded_bits = 20000000000ULL;
+    stats.entropy = 3.5;
+    stats.table_rebuilds = 2;
+
+    stats_print(&stats, file, true);
+    fclose(file);
+
+    CU_ASSERT(json[0] == '{');
+    CU_ASSERT(strcmp(json + size - 2, "}\n") == 0);
+    CU_ASSERT(json_balanced(json));
+
+    // counters past 32 bits are printed in full
+    CU_ASSERT(strstr(json, "\"encode\": 2.500") != NULL);
+    CU_ASSERT(strstr(json, "\"total_ms\": 2.500") != NULL);
+    CU_ASSERT(strstr(json, "\"bytes_in\": 5000000000,") != NULL);
+    CU_ASSERT(strstr(json, "\"bytes_out\": 3000000000,") != NULL);
+    CU_ASSERT(strstr(json, "\"blocks\": 3,") != NULL);
+    CU_ASSERT(strstr(json, "\"symbols\": 5000000000,") != NULL);
+    CU_ASSERT(strstr(json, "\"average_code_length\": 4.0000") != NULL);
+    CU_ASSERT(strstr(json, "\"entropy\": 3.5000") != NULL);
+    CU_ASSERT(strstr(json, "\"table_rebuilds\": 2,") != NULL);
+    CU_ASSERT(strstr(json, "\"memory\"") == NULL);
+
+    free(json);
+}
+
+void test_stats_print_json_memory()
+{
+    char *json = NULL;
+    size_t size = 0;
+    FILE *file = open_memstream(&json, &size);
+    memory_accounting_t *accounting = memory_accounting_new(NULL, 0);
+    allocator_t allocator = memory_accounting_allocator(accounting);
+    stats_t stats;
+
+    memory_set_allocator(&allocator);
+    void *data = memory_malloc(MEMORY_HUFFMAN, 100);
+
+    stats_init(&stats, NULL, NULL);
+    stats.memory = accounting;
+    stats_print(&stats, file, true);
+    fclose(file);
+
+    CU_ASSERT(json_balanced(json));
+    CU_ASSERT(strstr(json, "\"memory\": {\"huffman\": {\"current\": 100, ") != NULL);
+    CU_ASSERT(strstr(json, "\"total\": {\"current\": 100, ") != NULL);
+
+    memory_free(MEMORY_HUFFMAN, data);
+    memory_set_allocator(NULL);
+    memory_accounting_free(accounting);
+    free(json);
+}
+
+test_t STATS_TESTS[] = {
+    { "entropy", test_stats_entropy },
+    { "print JSON", test_stats_print_json },
+    { "print JSON with memory usage", test_stats_print_json_memory },
+    { NULL }
+};
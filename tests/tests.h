@@ -1,6 +1,7 @@
 #ifndef __TESTS_H__
 #define __TESTS_H__
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <CUnit/Basic.h>
 
@@ -9,6 +10,28 @@ typedef struct test {
     void (*func)(void);
 } test_t;
 
+/*
+ * Check that the braces and brackets of a JSON text outside its strings
+ * are balanced.
+ */
+bool json_balanced(const char *json);
+
+/*
+ * Bit array test functions.
+ */
+int init_suite_bit_array();
+int clean_suite_bit_array();
+
+extern test_t BIT_ARRAY_TESTS[];
+
+/*
+ * Rank and select index test functions.
+ */
+int init_suite_bit_index();
+int clean_suite_bit_index();
+
+extern test_t BIT_INDEX_TESTS[];
+
 /*
  * Heap test functions.
  */
@@ -17,6 +40,38 @@ int clean_suite_heap();
 
 extern test_t HEAP_TESTS[];
 
+/*
+ * List test functions.
+ */
+int init_suite_list();
+int clean_suite_list();
+
+extern test_t LIST_TESTS[];
+
+/*
+ * Stack test functions.
+ */
+int init_suite_stack();
+int clean_suite_stack();
+
+extern test_t STACK_TESTS[];
+
+/*
+ * Binary search tree test functions.
+ */
+int init_suite_tree();
+int clean_suite_tree();
+
+extern test_t TREE_TESTS[];
+
+/*
+ * MultiQueue test functions.
+ */
+int init_suite_multiqueue();
+int clean_suite_multiqueue();
+
+extern test_t MULTIQUEUE_TESTS[];
+
 /*
  * Huffman test functions.
  */
@@ -25,4 +80,44 @@ int clean_suite_huffman();
 
 extern test_t HUFFMAN_TESTS[];
 
+/*
+ * Asynchronous I/O test functions.
+ */
+int init_suite_aio();
+int clean_suite_aio();
+
+extern test_t AIO_TESTS[];
+
+/*
+ * Random-access reader test functions.
+ */
+int init_suite_reader();
+int clean_suite_reader();
+
+extern test_t READER_TESTS[];
+
+/*
+ * Memory allocator test functions.
+ */
+int init_suite_memory();
+int clean_suite_memory();
+
+extern test_t MEMORY_TESTS[];
+
+/*
+ * Statistics test functions.
+ */
+int init_suite_stats();
+int clean_suite_stats();
+
+extern test_t STATS_TESTS[];
+
+/*
+ * Tracer test functions.
+ */
+int init_suite_trace();
+int clean_suite_trace();
+
+extern test_t TRACE_TESTS[];
+
 #endif //__TESTS_H__
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "tests.h"
+#include "trace.h"
+
+static char path[] = "/tmp/huffman_trace_XXXXXX";
+
+int init_suite_trace()
+{
+    int fd = mkstemp(path);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    close(fd);
+    return 0;
+}
+
+int clean_suite_trace()
+{
+    unlink(path);
+    return 0;
+}
+
+// Read a whole file into a string
+static char *read_file(const char *name)
+{
+    FILE *file = fopen(name, "r");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+
+    char *data = malloc(size + 1);
+    data[fread(data, 1, size, file)] = '\0';
+    fclose(file);
+
+    return data;
+}
+
+// Find the event with a name and read its phase, timestamp and duration if it has one
+static bool find_event(const char *json, const char *name, char *phase, double *ts, double *dur)
+{
+    char key[64];
+    snprintf(key, sizeof(key), "{\"name\": \"%s\", ", name);
+
+    const char *event = strstr(json, key);
+    if (event == NULL)
+        return false;
+
+    *dur = -1;
+    return sscanf(event + strlen(key), "\"ph\": \"%c\", \"ts\": %lf, \"dur\": %lf",
+                  phase, ts, dur) >= 2;
+}
+
+void test_trace_spans()
+{
+    char phase;
+    double ts, dur, outer_ts, outer_dur;
+
+    CU_ASSERT(trace_start(path));
+    CU_ASSERT(trace_enabled());
+    CU_ASSERT(!trace_start(path));
+
+    trace_begin("outer", -1);
+    trace_begin("inner", 7);
+    usleep(1000);
+    trace_end("inner", 7);
+    trace_end("outer", -1);
+    trace_begin("open", -1);
+    trace_end("stray", -1);
+
+    CU_ASSERT(trace_stop());
+    CU_ASSERT(!trace_enabled());
+    CU_ASSERT(!trace_stop());
+
+    // events recorded while stopped are dropped
+    trace_begin("late", -1);
+
+    char *json = read_file(path);
+    CU_ASSERT(json != NULL);
+    if (json == NULL)
+        return;
+
+    CU_ASSERT(strncmp(json, "{\"traceEvents\": [", 17) == 0);
+    CU_ASSERT(strstr(json, "\"displayTimeUnit\": \"ns\"") != NULL);
+    CU_ASSERT(json_balanced(json));
+
+    // ended spans are complete events, the inner one inside the outer one
+    CU_ASSERT(find_event(json, "outer", &phase, &outer_ts, &outer_dur));
+    CU_ASSERT(phase == 'X');
+    CU_ASSERT(outer_ts >= 0);
+
+    CU_ASSERT(find_event(json, "inner", &phase, &ts, &dur));
+    CU_ASSERT(phase == 'X');
+    CU_ASSERT(dur >= 1000);
+    CU_ASSERT(ts >= outer_ts);
+    CU_ASSERT(ts + dur <= outer_ts + outer_dur);
+    CU_ASSERT(strstr(json, "\"args\": {\"block\": 7}") != NULL);
+
+    // a span left open keeps its begin event, an unmatched end its end event
+    CU_ASSERT(find_event(json, "open", &phase, &ts, &dur));
+    CU_ASSERT(phase == 'B' && dur < 0);
+    CU_ASSERT(find_event(json, "stray", &phase, &ts, &dur));
+    CU_ASSERT(phase == 'E' && dur < 0);
+
+    CU_ASSERT(strstr(json, "\"late\"") == NULL);
+
+    free(json);
+}
+
+test_t TRACE_TESTS[] = {
+    { "record spans", test_trace_spans },
+    { NULL }
+};
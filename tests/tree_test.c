@@ -0,0 +1,90 @@
+#include "tests.h"
+#include "tree.h"
+
+int init_suite_tree()
+{
+    return 0;
+}
+
+int clean_suite_tree()
+{
+    return 0;
+}
+
+static int cmp_ints(void *a, void *b)
+{
+    return (*(int*)a > *(int*)b) - (*(int*)a < *(int*)b);
+}
+
+void test_tree_find()
+{
+    int numbers[100];
+    tree_t *tree = tree_new(cmp_ints, NULL);
+
+    // insert the even numbers 0 to 198 in a scrambled order
+    for (int i = 0; i < 100; i++) {
+        numbers[i] = (i * 37 % 100) * 2;
+        tree_insert(tree, &numbers[i]);
+    }
+    CU_ASSERT(tree_size(tree) == 100);
+
+    bool found = true;
+    for (int key = 0; key < 200; key++) {
+        int *value = tree_find(tree, &key);
+        found &= (key % 2 == 0) ? (value != NULL && *value == key) : (value == NULL);
+        found &= (tree_has_key(tree, &key) == (key % 2 == 0));
+    }
+    CU_ASSERT(found);
+
+    int key = 74;
+    CU_ASSERT(tree_remove(tree, &key));
+    CU_ASSERT(!tree_has_key(tree, &key));
+    CU_ASSERT(!tree_remove(tree, &key));
+    CU_ASSERT(tree_size(tree) == 99);
+
+    tree_free(tree);
+}
+
+void test_tree_bounds()
+{
+    int numbers[] = { 50, 20, 80, 10, 30, 70, 90 };
+    tree_t *tree = tree_new(cmp_ints, NULL);
+
+    for (int i = 0; i < 7; i++) {
+        tree_insert(tree, &numbers[i]);
+    }
+
+    int key = 30;
+    CU_ASSERT(*(int*) tree_lower_bound(tree, &key) == 30);
+    CU_ASSERT(*(int*) tree_upper_bound(tree, &key) == 50);
+    key = 55;
+    CU_ASSERT(*(int*) tree_lower_bound(tree, &key) == 70);
+    CU_ASSERT(*(int*) tree_upper_bound(tree, &key) == 70);
+    key = 5;
+    CU_ASSERT(*(int*) tree_lower_bound(tree, &key) == 10);
+    key = 90;
+    CU_ASSERT(tree_upper_bound(tree, &key) == NULL);
+
+    // keys from 25 up to 75
+    key = 25;
+    int expected[] = { 30, 50, 70 };
+    int count = 0;
+    bool in_order = true;
+    iter_t *it = iter_tree_from(tree, &key);
+    while (iter_has_next(it)) {
+        int value = *(int*) iter_next(it);
+        if (value > 75)
+            break;
+        in_order &= (count < 3 && value == expected[count++]);
+    }
+    iter_free(it);
+    CU_ASSERT(in_order && count == 3);
+
+    tree_free(tree);
+}
+
+test_t TREE_TESTS[] = {
+    { "find, has key and remove", test_tree_find },
+    { "lower and upper bounds", test_tree_bounds },
+    { NULL }
+};